@@ -0,0 +1,308 @@
+/*
+====================
+File: bench.cc
+Author: Shane Lillie
+Description: Terrain and particle benchmarks
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+----
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#include "Terrain.h"
+#include "DirtParticle.h"
+#include "JobPool.h"
+#include "Random.h"
+
+
+/*
+ *  constants
+ *
+ */
+
+
+// the map size and simulation step the game uses
+const int MAP_WIDTH = 800;
+const int MAP_HEIGHT = 600;
+const float SIM_STEP = 1.0f / 240.0f;
+
+// sweeps per collision run
+const int SWEEPS = 1000;
+
+
+/*
+ *  globals
+ *
+ */
+
+
+std::string g_data_directory("data");
+int g_runs = 50;
+int g_threads = 0;
+
+JobPool* g_jobs = NULL;
+
+// results go here so the work can't be optimized out
+volatile int g_sink = 0;
+
+
+/*
+ *  functions
+ *
+ */
+
+
+// microseconds from some fixed point
+double now_usec()
+{
+#if defined WIN32
+    LARGE_INTEGER frequency, count;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&count);
+    return (static_cast<double>(count.QuadPart) * 1000000.0) / static_cast<double>(frequency.QuadPart);
+#else
+    // monotonic, so setting the clock can't make time jump
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (static_cast<double>(ts.tv_sec) * 1000000.0) + (ts.tv_nsec / 1000.0);
+#endif
+}
+
+
+// nearest-rank percentile of sorted samples
+double percentile(const std::vector<double>& sorted, int p)
+{
+    const int rank = static_cast<int>(std::ceil((p / 100.0) * sorted.size()));
+    return sorted[std::max(rank - 1, 0)];
+}
+
+
+// one tab separated line per benchmark, all times in microseconds
+void report(const std::string& name, std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    double total = 0.0;
+    for(unsigned int i=0; i<samples.size(); ++i)
+        total += samples[i];
+
+    std::printf("%s\t%d\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\n", name.c_str(), static_cast<int>(samples.size()),
+        samples.front(), percentile(samples, 50), percentile(samples, 90), percentile(samples, 99),
+        samples.back(), total / samples.size());
+    std::fflush(stdout);
+}
+
+
+std::string terrain_file(const char* const name)
+{
+    return g_data_directory + "/terrain/" + name;
+}
+
+
+void bench_load(const char* const name)
+{
+    std::vector<double> samples;
+    for(int i=0; i<g_runs; ++i) {
+        const double start = now_usec();
+        Terrain terrain(terrain_file(name), MAP_WIDTH, MAP_HEIGHT);
+        samples.push_back(now_usec() - start);
+    }
+    report(std::string("load_") + name, samples);
+}
+
+
+void bench_deform(const Terrain& base, int radius)
+{
+    const int x = MAP_WIDTH / 2;
+    const Vector3<float> pos(x, base.top(x), 0.0f);
+
+    std::vector<double> samples;
+    for(int i=0; i<g_runs; ++i) {
+        Terrain terrain(base);
+
+        const double start = now_usec();
+        terrain.deform(pos, radius);
+        samples.push_back(now_usec() - start);
+    }
+
+    char name[32];
+    std::snprintf(name, 32, "deform_r%d", radius);
+    report(name, samples);
+}
+
+
+void bench_slide(const Terrain& base)
+{
+    std::vector<double> samples;
+    for(int i=0; i<g_runs; ++i) {
+        Terrain terrain(base);
+
+        // hollow out under the surface so there's dirt to fall
+        for(int x=100; x<MAP_WIDTH; x+=150)
+            terrain.deform(Vector3<float>(x, terrain.top(x) - 80, 0.0f), 60);
+
+        const double start = now_usec();
+        while(!terrain.settled())
+            terrain.slide(SIM_STEP, g_jobs);
+        samples.push_back(now_usec() - start);
+    }
+    report("slide_settle", samples);
+}
+
+
+void bench_collision(const Terrain& base, float speed, int width, int height)
+{
+    Random random;
+    random.seed(1);
+
+    const float distance = speed * SIM_STEP;
+
+    std::vector<double> samples;
+    for(int i=0; i<g_runs; ++i) {
+        // start just above the ground, heading down
+        // at any angle, so about half of them hit
+        std::vector<Vector3<float> > from(SWEEPS), to(SWEEPS), velocity(SWEEPS);
+        for(int j=0; j<SWEEPS; ++j) {
+            const int x = random.range(MAP_WIDTH - width - 1);
+            const float angle = -static_cast<float>(random.range(180)) * 0.0174532925f;
+            const Vector3<float> v(std::cos(angle) * speed, std::sin(angle) * speed, 0.0f);
+
+            from[j] = Vector3<float>(x, base.top(x) + 1 + (distance / 2.0f), 0.0f);
+            to[j] = from[j] + (v * SIM_STEP);
+            velocity[j] = v;
+        }
+
+        Vector3<float> rest;
+        int hits = 0;
+
+        const double start = now_usec();
+        for(int j=0; j<SWEEPS; ++j)
+            hits += base.collision(from[j], to[j], velocity[j], &rest, width, height);
+        samples.push_back(now_usec() - start);
+
+        g_sink += hits;
+    }
+
+    char name[48];
+    std::snprintf(name, 48, "collide_%dx%d_v%d", width, height, static_cast<int>(speed));
+    report(name, samples);
+}
+
+
+void bench_impact(const Terrain& base)
+{
+    Random random;
+    random.seed(1);
+
+    const int x = MAP_WIDTH / 2;
+
+    std::vector<double> samples;
+    for(int i=0; i<g_runs; ++i) {
+        Terrain terrain(base);
+
+        // what a 280 pixel/sec shot coming down at 45 degrees throws up
+        const Vector3<float> pos(x, terrain.top(x) + 1, 0.0f);
+        terrain.deform(pos, 56);
+
+        const double start = now_usec();
+
+        DirtParticleSystem dirt(pos, -140.0f, -0.785398f, random);
+        dirt.emit_max();
+        while(!dirt.finished() || !terrain.settled()) {
+            dirt.update(&terrain, SIM_STEP, g_jobs);
+            if(!terrain.settled())
+                terrain.slide(SIM_STEP, g_jobs);
+        }
+
+        samples.push_back(now_usec() - start);
+    }
+    report("impact_500", samples);
+}
+
+
+void print_usage()
+{
+    std::cout << "Usage: bench [options]" << std::endl << std::endl
+            << "Options:" << std::endl
+            << "-data [dir]\tData directory (default data)" << std::endl
+            << "-runs [count]\tRuns of each benchmark (default 50)" << std::endl
+            << "-threads [count]\tSimulation threads (default one per processor)" << std::endl
+            << "-h\t\tPrint this message" << std::endl << std::endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+    for(int i=1; i<argc; ++i) {
+        if(!std::strcmp("-data", argv[i]) && i + 1 < argc)
+            g_data_directory = argv[++i];
+        else if(!std::strcmp("-runs", argv[i]) && i + 1 < argc)
+            g_runs = std::max(std::atoi(argv[++i]), 1);
+        else if(!std::strcmp("-threads", argv[i]) && i + 1 < argc)
+            g_threads = std::atoi(argv[++i]);
+        else {
+            print_usage();
+            return std::strcmp("-h", argv[i]) ? 1 : 0;
+        }
+    }
+
+    JobPool jobs(g_threads > 0 ? g_threads : JobPool::cpu_count());
+    g_jobs = &jobs;
+
+    std::printf("# name\truns\tmin_us\tp50_us\tp90_us\tp99_us\tmax_us\tmean_us\n");
+
+    try {
+        bench_load("test.set");
+        bench_load("test.stb");
+
+        const Terrain base(terrain_file("test.stb"), MAP_WIDTH, MAP_HEIGHT);
+
+        const int radii[] = { 10, 25, 50, 100, 200 };
+        for(unsigned int i=0; i<sizeof(radii) / sizeof(radii[0]); ++i)
+            bench_deform(base, radii[i]);
+
+        bench_slide(base);
+
+        const float speeds[] = { 60.0f, 240.0f, 960.0f, 3840.0f };
+        for(unsigned int i=0; i<sizeof(speeds) / sizeof(speeds[0]); ++i) {
+            bench_collision(base, speeds[i], 2, 2);
+            bench_collision(base, speeds[i], 32, 16);
+        }
+
+        bench_impact(base);
+    } catch(Terrain::TerrainException& e) {
+        std::cerr << "Could not load the terrain: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
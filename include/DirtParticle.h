@@ -2,7 +2,7 @@
 ====================
 File: DirtParticle.h
 Author: Shane Lillie
-Description: Dirt particle system subclass
+Description: Dirt particle system header
 
 Copyright 2003 Energon Software
 
@@ -26,23 +26,35 @@ Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 #define DIRTPARTICLE_H
 
 
-#include "Particle.h"
+#include <vector>
 
+#include "Vector.h"
 
-class DirtParticleSystem : public ParticleSystem
+
+class Random;
+class Terrain;
+class JobPool;
+
+
+/*
+ *  DirtParticleSystem class
+ *
+ *  the particles are kept structure-of-arrays in one block
+ *  allocated up front, with the live ones packed at the front
+ *
+ */
+
+
+class DirtParticleSystem
 {
 private:
-    class DirtParticle : public Particle
-    {
-    public:
-        DirtParticle(const Vector3<float>& position, const Vector3<float>& velocity, unsigned int texture);
-
-    private:
-        virtual void on_update(World* const world, float elapsed_sec, const Particle* const head);
-        virtual void on_render(int window_width, int window_height) const;
+    enum ParticleState { Flying, Landed, Lost };
 
-    private:
-        unsigned int m_texture;
+    // particles begin .. end-1 of one system, for update_all()
+    struct Chunk
+    {
+        DirtParticleSystem* system;
+        int begin, end;
     };
 
 private:
@@ -50,27 +62,89 @@ private:
     static const int PARTICLE_HEIGHT;
     static const int MAX_PARTICLES;
 
+    // particles per update job
+    static const int UPDATE_GRAIN;
+
 public:
-    DirtParticleSystem(const Vector3<float>& origin, float force, float angle);
+    DirtParticleSystem(const Vector3<float>& origin, float force, float angle, Random& random);
     virtual ~DirtParticleSystem();
 
-private:
-    void create_texture();
-    void delete_texture();
+public:
+    // fills the system up with particles
+    void emit_max();
 
-private:
-    virtual void on_update(World* const world, float elapsed_sec)
+    // moves every particle, the ones that land
+    // are added back into the terrain
+    // the moves are spread over the jobs if there are any
+    void update(Terrain* const terrain, float elapsed_sec, JobPool* const jobs=NULL);
+
+    // update() for a set of systems, with every system's
+    // particles moved in the one set of jobs
+    static void update_all(const std::vector<DirtParticleSystem*>& systems, Terrain* const terrain, float elapsed_sec, JobPool* const jobs=NULL);
+
+    // renders in a width x height view with its bottom left at view_x, view_y
+    void render(int view_x, int view_y, int width, int height) const;
+
+    // true once every particle has landed
+    bool finished() const { return m_count == 0; }
+
+    int count() const { return m_count; }
+
+    // how far between the last two updates to draw the particles
+    void set_alpha(float alpha)
     {
+        m_alpha = alpha;
     }
 
-    virtual Particle* const on_add() const;
-    virtual void on_render(const Particle* const particle, int window_width, int window_height) const;
+private:
+    void create_texture() const;
+    void release_texture();
+
+    // swaps the last live particle into i
+    void kill(int i);
+
+    // adds the particles that hit to the terrain
+    void land(Terrain* const terrain);
+
+    // update job, moves particles begin .. end-1
+    static void update_particles(void* data, int begin, int end);
+
+    // update_all() job, runs chunks begin .. end-1
+    static void update_chunks(void* data, int begin, int end);
 
 private:
+    Vector3<float> m_origin;
     float m_force, m_angle;
     Vector3<float> m_initial_velocity;
 
-    unsigned int m_texture;
+    Random* m_random;
+    float m_alpha;
+
+    // MAX_PARTICLES floats per array
+    std::vector<float> m_pool;
+    float *m_x, *m_y, *m_prev_x, *m_prev_y, *m_vx, *m_vy;
+    float *m_next_x, *m_next_y;
+
+    // what happened to each particle in the last update
+    std::vector<unsigned char> m_landed;
+
+    // live particles are 0 .. m_count-1
+    int m_count;
+
+    // the update in progress, shared with the jobs
+    const Terrain* m_terrain;
+    float m_elapsed_sec;
+
+    // render arrays, only allocated once we draw
+    mutable std::vector<float> m_vertices, m_texcoords;
+    mutable unsigned int m_texture;
+
+    // the system's lifetime on the Timeline
+    int m_timeline_id;
+
+private:
+    DirtParticleSystem(const DirtParticleSystem&);
+    DirtParticleSystem& operator=(const DirtParticleSystem&);
 };
 
 #endif
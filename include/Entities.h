@@ -0,0 +1,129 @@
+/*
+====================
+File: Entities.h
+Author: Shane Lillie
+Description: Projectile and effect store header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#if !defined ENTITIES_H
+#define ENTITIES_H
+
+
+#include <vector>
+
+#include "Vector.h"
+
+
+class DirtParticleSystem;
+class JobPool;
+class Random;
+class SpriteMask;
+class Terrain;
+
+
+/*
+ *  Entities class
+ *
+ *  everything that's in the air at once: the projectiles in flight,
+ *  kept structure-of-arrays like the dirt particles, and the bursts
+ *  (a dirt particle system and the smoke puff over it) left by impacts
+ *
+ *  each kind is updated all at once, and impacts are collected
+ *  so the caller can deform the terrain for all of them together
+ *
+ */
+
+
+class Entities
+{
+public:
+    // where a projectile hit and how fast it was going
+    struct Impact
+    {
+        Vector3<float> pos, vel;
+    };
+
+private:
+    // warheads fly apart this fast (in each direction) when they split
+    static const int SPLIT_SPREAD;
+
+public:
+    Entities();
+    virtual ~Entities();
+
+public:
+    // a projectile that splits into warheads at the top of its arc
+    void add_projectile(const Vector3<float>& pos, const Vector3<float>& vel, int warheads=0);
+
+    // a burst of dirt (at half the impact velocity) and smoke,
+    // the dirt is emitted right away
+    void add_burst(const Impact& impact, const Vector3<float>& pos, Random& random);
+
+    // moves every projectile, the ones that hit the terrain
+    // are removed and added to impacts
+    // random is for the warheads
+    void update_projectiles(const Terrain& terrain, const SpriteMask& mask, float elapsed_sec, Random& random, std::vector<Impact>& impacts);
+
+    // moves every burst, the ones that are done
+    // (once the terrain has settled) are removed
+    void update_bursts(Terrain* const terrain, float elapsed_sec, JobPool* const jobs=NULL);
+
+    // deletes everything
+    void clear();
+
+    // true if nothing is in the air
+    bool empty() const { return m_x.empty() && m_dirt.empty(); }
+
+    int projectiles() const { return m_x.size(); }
+    int bursts() const { return m_dirt.size(); }
+    int particles() const;
+
+    // where projectile i is, alpha of the way through the last step
+    Vector3<float> projectile(int i, float alpha) const;
+    Vector3<float> projectile_velocity(int i) const;
+
+    // where the smoke of burst i is, alpha of the way through the last step
+    Vector3<float> smoke(int i, float alpha) const;
+
+    // renders every burst's dirt in a width x height view
+    // with its bottom left at x, y
+    void render(float alpha, int x, int y, int width, int height) const;
+
+private:
+    // swaps the last projectile into i
+    void remove_projectile(int i);
+
+private:
+    // projectiles, one entry each
+    std::vector<float> m_x, m_y, m_prev_x, m_prev_y, m_vx, m_vy;
+    std::vector<int> m_warheads;
+
+    // bursts, one entry each
+    std::vector<DirtParticleSystem*> m_dirt;
+    std::vector<Vector3<float> > m_smoke, m_smoke_prev;
+
+private:
+    Entities(const Entities&);
+    Entities& operator=(const Entities&);
+};
+
+
+#endif
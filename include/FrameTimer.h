@@ -0,0 +1,142 @@
+/*
+====================
+File: FrameTimer.h
+Author: Shane Lillie
+Description: Per-frame phase timing header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+#if !defined FRAMETIMER_H
+#define FRAMETIMER_H
+
+
+#include <vector>
+
+#include "Timeline.h"
+
+
+/*
+ *  FrameTimer class
+ *
+ *  times the phases of each frame (or simulation step)
+ *  into a ring buffer of the last FRAMES frames, so a slow
+ *  frame can be broken down after the fact
+ *
+ *  phases also go on the Timeline when it's recording
+ *
+ */
+
+
+class FrameTimer
+{
+public:
+    enum Phase
+    {
+        Background,
+        TerrainRender,
+        Sprites,
+        ParticleRender,
+        Hud,
+        Flip,
+        TankPhysics,
+        ParticleUpdate,
+        Slide,
+        Projectile,
+        Frame,          // the whole frame, begin_frame() to end_frame()
+        PhaseCount
+    };
+
+    // times a phase for as long as it's in scope
+    class Scope
+    {
+    public:
+        Scope(FrameTimer& timer, Phase phase)
+            : m_timer(timer), m_phase(phase), m_start(FrameTimer::now())
+        {
+        }
+
+        ~Scope()
+        {
+            const double end = FrameTimer::now();
+            m_timer.add(m_phase, end - m_start);
+            Timeline::span(FrameTimer::name(m_phase), m_start, end);
+        }
+
+    private:
+        FrameTimer& m_timer;
+        Phase m_phase;
+        double m_start;
+
+    private:
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+    };
+
+public:
+    static const int FRAMES;
+
+public:
+    // microseconds from some fixed point
+    static double now();
+
+    static const char* name(Phase phase);
+
+public:
+    FrameTimer();
+
+public:
+    // phases outside of a frame aren't recorded
+    void begin_frame();
+    void end_frame();
+
+    // a phase can run more than once a frame, it adds up
+    void add(Phase phase, double usec)
+    {
+        if(m_in_frame)
+            m_current[phase] += static_cast<float>(usec);
+    }
+
+    // finished frames in the ring
+    int frames() const { return m_count; }
+
+    // microseconds a phase took in the last finished frame
+    float last(Phase phase) const;
+
+    // microseconds a phase took over the frames in the ring,
+    // p is 0 .. 100
+    float percentile(Phase phase, int p) const;
+
+    // writes p50/p95/p99 of every phase to the log
+    void log() const;
+
+private:
+    // FRAMES rows of PhaseCount samples
+    std::vector<float> m_samples;
+    float m_current[PhaseCount];
+
+    int m_next, m_count;
+    double m_frame_start;
+    bool m_in_frame;
+
+    // scratch for percentile()
+    mutable std::vector<float> m_sorted;
+};
+
+
+#endif
@@ -0,0 +1,117 @@
+/*
+====================
+File: JobPool.h
+Author: Shane Lillie
+Description: Work-stealing job pool header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+#if !defined JOBPOOL_H
+#define JOBPOOL_H
+
+
+#include <deque>
+#include <vector>
+
+#include "SDL.h"
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+
+
+/*
+ *  JobPool class
+ *
+ *  a fixed set of worker threads, each with its own locked deque
+ *  workers take their own jobs from the back and steal
+ *  from the front of everyone else's when they run dry
+ *
+ */
+
+
+class JobPool
+{
+public:
+    // runs items begin .. end-1
+    typedef void (*JobFunction)(void* data, int begin, int end);
+
+private:
+    struct Job
+    {
+        JobFunction function;
+        void* data;
+        int begin, end;
+    };
+
+    struct Queue
+    {
+        std::deque<Job> jobs;
+        SDL_mutex* lock;
+    };
+
+    struct Worker
+    {
+        JobPool* pool;
+        int index;
+        SDL_Thread* thread;
+    };
+
+public:
+    // number of processors we're running on
+    static int cpu_count();
+
+public:
+    // threads is the total, including the calling thread
+    explicit JobPool(int threads);
+    virtual ~JobPool();
+
+public:
+    int threads() const { return m_queues.size(); }
+
+    // splits 0 .. count-1 into chunks of at most grain items
+    // and spreads them over the workers, the calling thread helps out
+    // doesn't return until every chunk has run
+    void parallel_for(JobFunction function, void* data, int count, int grain);
+
+private:
+    static int worker_main(void* data);
+
+    // takes from the back of our own queue, or steals from the front of another
+    bool pop(int index, Job& job);
+    void run(const Job& job);
+
+private:
+    std::vector<Queue> m_queues;
+    std::vector<Worker> m_workers;
+
+    // guards the counters below, workers sleep on m_wake
+    // and parallel_for waits on m_done
+    SDL_mutex* m_lock;
+    SDL_cond* m_wake;
+    SDL_cond* m_done;
+
+    int m_queued, m_pending;
+    bool m_quit;
+
+private:
+    JobPool(const JobPool&);
+    JobPool& operator=(const JobPool&);
+};
+
+
+#endif
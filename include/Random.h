@@ -0,0 +1,77 @@
+/*
+====================
+File: Random.h
+Author: Shane Lillie
+Description: Seedable random number generator header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+#if !defined RANDOM_H
+#define RANDOM_H
+
+
+#include "SDL.h"
+
+
+/*
+ *  Random class
+ *
+ *  xorshift generator, so a seed gives the same
+ *  sequence on every platform (unlike rand())
+ *
+ */
+
+
+class Random
+{
+public:
+    explicit Random(Uint32 seed=1)
+    {
+        this->seed(seed);
+    }
+
+public:
+    void seed(Uint32 seed);
+
+    Uint32 next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+
+    // 0 .. max-1
+    int range(int max)
+    {
+        return max > 0 ? static_cast<int>(next() % static_cast<Uint32>(max)) : 0;
+    }
+
+    // min .. max-1
+    int range(int min, int max)
+    {
+        return min + range(max - min);
+    }
+
+private:
+    Uint32 m_state;
+};
+
+
+#endif
@@ -27,12 +27,26 @@ Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 #define SEARTH_H
 
 
+#include <ctime>
+#include <string>
+#include <vector>
+
 #include "SDL_opengl.h"
 
 #include "Engine.h"
+#include "Entities.h"
+#include "FrameTimer.h"
+#include "Random.h"
+#include "Tanks.h"
+#include "Vector.h"
 
 
 class Terrain;
+class JobPool;
+class SpriteBatch;
+class LogicalFont;
+class TextAtlas;
+class SpriteMask;
 
 
 /*
@@ -43,6 +57,15 @@ class Terrain;
 
 class SEarth : public Engine
 {
+public:
+    enum Weapon
+    {
+        Shell,          // one projectile
+        ClusterBomb,    // a spread of them at once
+        Mirv,           // one that splits at the top of its arc
+        WeaponCount
+    };
+
 private:
 /* TODO: put this shit in the Engine class... */
     struct State
@@ -58,10 +81,32 @@ private:
         bool paused;
         bool fps;
 
+        // per phase frame times on the HUD
+        bool timings;
+
+        // shots to simulate without a window, 0 to play normally
+        int headless_shots;
+
+        // the same seed always plays out the same
+        Uint32 seed;
+
+        // simulation threads, 0 for one per processor
+        int threads;
+
+        // Chrome trace of the session, empty for none
+        std::string trace_file;
+
+        Weapon weapon;
+
+        // tanks in the match, they take turns
+        int tanks;
+
         State()
             : window_depth(16), fullscreen(false),
                 music(true), sounds(true),
-                paused(false), fps(/*false*/true)
+                paused(false), fps(/*false*/true), timings(false),
+                headless_shots(0), seed(static_cast<Uint32>(std::time(NULL))),
+                threads(0), weapon(Shell), tanks(1)
         {
         }
     };
@@ -91,12 +136,70 @@ public:
         m_state.sounds = sounds;
     }
 
+    void set_headless(int shots)
+    {
+        m_state.headless_shots = shots;
+    }
+
+    void set_seed(Uint32 seed)
+    {
+        m_state.seed = seed;
+    }
+
+    void set_threads(int threads)
+    {
+        m_state.threads = threads;
+    }
+
+    void set_trace(const std::string& filename)
+    {
+        m_state.trace_file = filename;
+    }
+
+    void set_weapon(Weapon weapon)
+    {
+        m_state.weapon = weapon;
+    }
+
+    void set_tanks(int tanks)
+    {
+        m_state.tanks = tanks;
+    }
+
+    static const char* weapon_name(Weapon weapon);
+
 private:
     bool create_window(const std::string& title);
     bool setup_extensions() const;
     void render_hud();
     void screenshot() const;
 
+    // loads the terrain and the sprites the simulation collides with
+    // a binary map is its own size, a .set map is width x height
+    bool load_world(int width, int height);
+
+    // steps everything forward, no GL calls
+    void simulate(float elapsed_sec);
+
+    // alpha is how far we are between the last two steps
+    void render(float alpha);
+
+    // finishes timing a frame and puts the
+    // counters on the timeline if it's recording
+    void end_frame();
+
+    // launches the current weapon from the aim
+    void fire();
+
+    // keeps the view on the map and hands it to the terrain
+    void update_view();
+
+    // queues a projectile and its flare, turned to face vel
+    void draw_projectile(const Vector3<float>& pos, const Vector3<float>& vel);
+
+    // simulates the headless shots as fast as we can
+    bool run_headless();
+
 public:
     virtual bool main();
 
@@ -112,6 +215,45 @@ private:
 private:
     State m_state;
     Terrain* m_terrain;
+
+    int m_background, m_tank, m_flare, m_projectile, m_smoke;
+
+    // every tank, and whose turn it is
+    Tanks m_tanks;
+    int m_turn;
+
+    int m_shots, m_impact_radius;
+
+    // everything in the air, and where the next shot goes
+    Entities m_entities;
+    Vector3<float> m_aim_pos, m_aim_vel;
+
+    // bottom left of the part of the map in the window
+    int m_view_x, m_view_y;
+
+    // reused every step
+    std::vector<Entities::Impact> m_impacts;
+
+    Random m_random;
+    float m_accumulator;
+
+    // where the time in each frame went
+    FrameTimer m_timer;
+
+    // every sprite goes through here, built on the first render
+    SpriteBatch* m_sprites;
+
+    // the HUD font and its glyphs, loaded on the first render
+    LogicalFont* m_hud_font;
+    TextAtlas* m_hud_text;
+
+    // what the tank and projectile collide with
+    SpriteMask* m_tank_mask;
+    SpriteMask* m_projectile_mask;
+
+    // the simulate() barrier, everything it
+    // starts is finished before we render
+    JobPool* m_jobs;
 };
 
 
@@ -0,0 +1,172 @@
+/*
+====================
+File: SpriteBatch.h
+Author: Shane Lillie
+Description: Sprite batching header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+#if !defined SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+
+#include <map>
+#include <vector>
+
+#include "SDL.h"
+
+
+/*
+ *  SpriteBatch class
+ *
+ *  packs the sprite images into one texture atlas
+ *  (repeating images get a texture of their own), queues
+ *  sprites up by draw() and sends them out from flush()
+ *  sorted by blend mode and texture, in one ortho setup
+ *  and one draw call per run of the same state
+ *
+ */
+
+
+class SpriteBatch
+{
+public:
+    enum Blend
+    {
+        BlendNone,      // opaque, blending is turned off
+        BlendAlpha      // whatever the blend state is
+    };
+
+    struct Sprite
+    {
+        int surface;
+        Blend blend;
+
+        // the quad around the origin, before it's rotated
+        float left, bottom, right, top;
+
+        // where the origin goes and the rotation (in degrees) around it
+        float x, y, angle;
+
+        // times the image repeats across the quad
+        // (only for images added as repeating)
+        float s, t;
+
+        float r, g, b;
+
+        // the image at its own size with the bottom left at x, y
+        Sprite(int image, float px, float py, int width, int height)
+            : surface(image), blend(BlendAlpha),
+                left(0.0f), bottom(0.0f), right(width - 1.0f), top(height - 1.0f),
+                x(px), y(py), angle(0.0f), s(1.0f), t(1.0f),
+                r(1.0f), g(1.0f), b(1.0f)
+        {
+        }
+    };
+
+private:
+    // where an image ended up
+    struct Image
+    {
+        bool repeat;
+        unsigned int texture;
+        float s1, t1, s2, t2;   // t1 is the top row
+
+        Image() : repeat(false), texture(0), s1(0.0f), t1(0.0f), s2(1.0f), t2(1.0f)
+        {
+        }
+    };
+
+    // a queued sprite, in the order it was drawn
+    struct Quad
+    {
+        int order;
+        Blend blend;
+        unsigned int texture;
+
+        float vertices[8];
+        float texcoords[8];
+        Uint8 color[4];
+
+        bool operator<(const Quad& rhs) const
+        {
+            if(blend != rhs.blend)
+                return blend < rhs.blend;
+            if(texture != rhs.texture)
+                return texture < rhs.texture;
+            return order < rhs.order;
+        }
+    };
+
+private:
+    static const int ATLAS_WIDTH;
+
+    // empty pixels between atlas images so filtering doesn't bleed
+    static const int ATLAS_PADDING;
+
+public:
+    SpriteBatch();
+    virtual ~SpriteBatch();
+
+public:
+    // adds an image (engine surface) to draw sprites from,
+    // repeating images get their own texture so they can tile
+    // returns false if the surface isn't loaded
+    bool add(int surface, bool repeat=false);
+
+    // queues a sprite, unknown images are ignored
+    void draw(const Sprite& sprite);
+
+    // queues an image at its own size with the bottom left at x, y
+    void draw(int surface, float x, float y, Blend blend=BlendAlpha);
+
+    // draws everything queued in a width x height ortho view
+    // with its bottom left at x, y
+    void flush(int x, int y, int width, int height);
+
+    // number of draw calls in the last flush
+    int batches() const { return m_batches; }
+
+private:
+    // packs the images and gets their textures from the cache
+    // needs a GL context
+    bool build();
+    void release_textures();
+
+private:
+    std::map<int, Image> m_images;
+    unsigned int m_atlas;
+    int m_atlas_height;
+    bool m_built;
+
+    std::vector<Quad> m_quads;
+    int m_batches;
+
+    // reused every flush, so drawing doesn't allocate
+    // once they've grown to fit
+    std::vector<float> m_vertices, m_texcoords;
+    std::vector<Uint8> m_colors;
+
+private:
+    SpriteBatch(const SpriteBatch&);
+    SpriteBatch& operator=(const SpriteBatch&);
+};
+
+
+#endif
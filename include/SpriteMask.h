@@ -0,0 +1,72 @@
+/*
+====================
+File: SpriteMask.h
+Author: Shane Lillie
+Description: Sprite collision mask header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+#if !defined SPRITEMASK_H
+#define SPRITEMASK_H
+
+
+#include <cassert>
+#include <vector>
+
+#include "TerrainBitmap.h"
+
+
+/*
+ *  SpriteMask class
+ *
+ *  the solid (not clear black) pixels of a sprite, bit-packed
+ *  the same way as the terrain so collision is a word-wise AND
+ *  row 0 is the bottom of the sprite's footprint on the map
+ *
+ */
+
+
+class SpriteMask
+{
+public:
+    // builds the mask from a loaded surface, locking it once
+    explicit SpriteMask(int surface);
+
+public:
+    int width() const { return m_bits.width(); }
+    int height() const { return m_bits.height(); }
+    int words_per_column() const { return m_bits.words_per_column(); }
+
+    const TerrainBitmap::Word* column(int x) const { return m_bits.column(x); }
+
+    // the first clear row of a column, counting up from row 0
+    // (height() if the column is solid the whole way)
+    int first_clear(int x) const
+    {
+        assert(x >= 0 && x < width());
+        return m_first_clear[x];
+    }
+
+private:
+    TerrainBitmap m_bits;
+    std::vector<int> m_first_clear;
+};
+
+
+#endif
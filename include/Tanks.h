@@ -0,0 +1,103 @@
+/*
+====================
+File: Tanks.h
+Author: Shane Lillie
+Description: Tank store header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#if !defined TANKS_H
+#define TANKS_H
+
+
+#include <vector>
+
+#include "Vector.h"
+
+
+class SpriteMask;
+class Terrain;
+
+
+/*
+ *  Tanks class
+ *
+ *  every tank, structure-of-arrays, falling under gravity
+ *  until it comes to rest on the terrain
+ *
+ *  a resting tank is skipped until a column under it changes
+ *  (Terrain::changed_since), so a match only pays for the
+ *  tanks a crater or falling dirt actually touched
+ *
+ */
+
+
+class Tanks
+{
+public:
+    Tanks();
+    virtual ~Tanks();
+
+public:
+    void add(const Vector3<float>& pos);
+
+    // wakes the tanks whose columns changed, then moves the
+    // awake ones, mask is what every tank collides with
+    void update(const Terrain& terrain, const SpriteMask& mask, float elapsed_sec);
+
+    void clear();
+
+    int count() const { return m_x.size(); }
+    int awake() const;
+
+    // true if the tank is sitting still on the ground
+    bool resting(int i) const
+    {
+        return m_resting[i] != 0;
+    }
+
+    Vector3<float> position(int i) const
+    {
+        return Vector3<float>(m_x[i], m_y[i], 0.0f);
+    }
+
+    // where the tank is, alpha of the way through the last step
+    Vector3<float> position(int i, float alpha) const
+    {
+        return Vector3<float>(m_prev_x[i] + ((m_x[i] - m_prev_x[i]) * alpha), m_prev_y[i] + ((m_y[i] - m_prev_y[i]) * alpha), 0.0f);
+    }
+
+private:
+    std::vector<float> m_x, m_y, m_prev_x, m_prev_y, m_vx, m_vy;
+
+    // where the awake tanks are headed this step
+    std::vector<float> m_next_x, m_next_y;
+
+    // Terrain::changes() when a resting tank came to rest
+    std::vector<unsigned char> m_resting;
+    std::vector<unsigned int> m_rested_at;
+
+private:
+    Tanks(const Tanks&);
+    Tanks& operator=(const Tanks&);
+};
+
+
+#endif
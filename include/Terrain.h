@@ -26,10 +26,19 @@ Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 #define TERRAIN_H
 
 
+#include <algorithm>
+#include <cassert>
+#include <climits>
 #include <stdexcept>
+#include <vector>
 
 #include "World.h"
 #include "Vector.h"
+#include "TerrainBitmap.h"
+
+
+class JobPool;
+class SpriteMask;
 
 
 class Terrain : public World
@@ -45,7 +54,64 @@ public:
         std::string _what;
     };
 
+    // inclusive rectangle of changed pixels
+    struct Rect
+    {
+        int x1, y1, x2, y2;
+
+        Rect() : x1(INT_MAX), y1(INT_MAX), x2(INT_MIN), y2(INT_MIN)
+        {
+        }
+
+        Rect(int left, int bottom, int right, int top)
+            : x1(left), y1(bottom), x2(right), y2(top)
+        {
+        }
+
+        bool empty() const { return x1 > x2 || y1 > y2; }
+        int width() const { return x2 - x1 + 1; }
+        int height() const { return y2 - y1 + 1; }
+
+        void extend(int x, int y)
+        {
+            x1 = std::min(x1, x); y1 = std::min(y1, y);
+            x2 = std::max(x2, x); y2 = std::max(y2, y);
+        }
+
+        void extend(const Rect& rect)
+        {
+            if(rect.empty()) return;
+            extend(rect.x1, rect.y1);
+            extend(rect.x2, rect.y2);
+        }
+    };
+
+private:
+    // one square texture per tile of the map
+    struct Tile
+    {
+        unsigned int texture;
+
+        // tile-relative area that needs uploading
+        Rect dirty;
+
+        Tile() : texture(0)
+        {
+        }
+    };
+
+private:
+    static const int TILE_SIZE;
+
+    // transparent black
+    static const Uint32 CLEAR_PIXEL;
+
+    // unsettled columns per slide job
+    static const int SLIDE_GRAIN;
+
 public:
+    // a binary map is the size it was converted at,
+    // a .set map is width x height
     Terrain(const std::string& filename, int width, int height) throw(TerrainException);
     virtual ~Terrain();
 
@@ -56,53 +122,159 @@ ceiling collision isn't collision
 
 public:
     // tests for a collision on a per-pixel level
-    bool collision(const Vector3<float>& s0, const Vector3<float>& s1, const Vector3<float>& v, Vector3<float>* const s2, int surface) const;
+    bool collision(const Vector3<float>& s0, const Vector3<float>& s1, const Vector3<float>& v, Vector3<float>* const s2, const SpriteMask& mask) const;
 
     // deforms the terrain in a circle
-    // r=1..radius (inclusive)
-    void deform(const Vector3<float>& pos, int radius);
+    // returns the (clipped) bounding box of the crater
+    Rect deform(const Vector3<float>& pos, int radius);
 
-    // slides the dirt down
+    // slides the dirt down in the unsettled columns,
+    // spread over the jobs if there are any
     // retrurns true if dirt actually fell
-    bool slide(float elapsed_sec);
+    bool slide(float elapsed_sec, JobPool* const jobs=NULL);
+
+    // true if no column has dirt left to fall
+    bool settled() const { return m_unsettled.empty(); }
+
+    // columns that still have dirt to fall
+    int unsettled_columns() const { return m_unsettled.size(); }
+
+    // bytes of color sent to the card so far
+    unsigned int uploaded_bytes() const { return m_uploaded_bytes; }
+
+    // goes up with every deform, deposit and slide that changes the map
+    unsigned int changes() const { return m_changes; }
+
+    // true if any column x1 .. x2 changed after changes() was change
+    bool changed_since(int x1, int x2, unsigned int change) const;
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    // highest solid row in a column, -1 if it's empty
+    // (cached, so this is cheap)
+    int top(int x) const
+    {
+        assert(x >= 0 && x < m_width);
+        return m_tops[x];
+    }
+
+    // adds a width x height block of dirt at pos,
+    // it slides down onto whatever is under it
+    void deposit(const Vector3<float>& pos, int width, int height);
 
     // generates the terrain textures
-    // doesn't modify or re-create the surfaces
+    // colors the map first if it hasn't been yet
     void generate_textures();
 
+    // uploads only the parts of the visible tiles
+    // that changed since the last upload
+    void update_textures();
+
+    // sets the part of the map that render() draws
+    void set_view(int x, int y, int width, int height);
+
     // returns the amount that a tank would
     // fall based on how much ground
     // is underneath it
-    int would_fall(int x, int y, int surface);
+    int would_fall(int x, int y, const SpriteMask& mask) const;
 
 public:
     virtual void render();
     virtual bool collision(const Vector3<float>& s0, const Vector3<float>& s1, const Vector3<float>& v, Vector3<float>* const s2, int width, int height) const;
 
 private:
-    void create_textures();
+    // fills in the colors from the bitmap and the ramp
+    void color();
+    bool colored() const { return !m_pixels.empty(); }
+
     void delete_textures();
+    void upload_tile(int tx, int ty, bool full);
+
+    // adds a column to the unsettled set,
+    // dirt from row y up may fall
+    void unsettle(int x, int y);
+
+    // compacts one column from the start row up,
+    // dropping each cell at most distance rows
+    // returns the rows that changed, it's safe to run
+    // on different columns at the same time
+    Rect slide(int column, int start, int distance);
+
+    // slide job, unsettled columns begin .. end-1
+    static void slide_columns(void* data, int begin, int end);
+
+    // walks the cells between s0 and s1, testing the footprint once per cell
+    // the footprint is the mask, or the whole box without one
+    bool sweep(const Vector3<float>& s0, const Vector3<float>& s1, const Vector3<float>& v, Vector3<float>* const s2, int width, int height, const SpriteMask* const mask) const;
+    void unstick(const Vector3<float>& s0, const Vector3<float>& v, Vector3<float>* const s2, int width, int height, const SpriteMask* const mask) const;
+
+    // true if a box moving from s0 to s1 stays above every column top,
+    // so it can't hit anything
+    bool above_ground(const Vector3<float>& s0, const Vector3<float>& s1, int width) const;
+
+    // footprint tests at a cell, out of bounds is a hit
+    bool hit(int x, int y, const SpriteMask& mask) const;
+    bool hit(int x, int y, int width, int height) const;
 
-    void lock_surfaces();
-    void unlock_surfaces();
-    void free_surfaces();
+    // sizes an empty width x height map
+    void resize(int width, int height);
 
-    bool slide(int column, int start, float elapsed_sec);
-    bool collision(const Vector3<float>& pos, int surface) const;
-    bool collision(const Vector3<float>& pos, int width, int height) const;
+    // clears the pixels x1..x2 (inclusive) of a map row
+    void clear_row(int y, int x1, int x2);
 
-    void remove_point(int x, int y);
-    void swap_points(int x1, int y1, int x2, int y2);
+    // the color of a map cell
+    Uint32* pixel_at(int x, int y);
+
+    // a tile's colors, TILE_SIZE rows of TILE_SIZE pixels
+    Uint32* tile_pixels(int tx, int ty) { return &m_pixels[((ty * m_tiles_x) + tx) * TILE_SIZE * TILE_SIZE]; }
+
+    Tile& tile(int tx, int ty) { return m_tiles[(ty * m_tiles_x) + tx]; }
+    const Tile& tile(int tx, int ty) const { return m_tiles[(ty * m_tiles_x) + tx]; }
+
+    // range of tiles (inclusive) inside the view
+    Rect visible_tiles() const;
+
+    // marks an area as needing upload
+    void mark_dirty(const Rect& rect);
 
 public:
-    bool** m_terrain;
+    TerrainBitmap m_terrain;
     int m_width, m_height;
 
-    int m_surfaces[3];
-    unsigned int m_textures[3];
+    int m_tiles_x, m_tiles_y;
+    std::vector<Tile> m_tiles;
+
+    // RGBA8 colors of the map, one tile after another so each
+    // tile uploads straight out of here (empty until colored)
+    std::vector<Uint32> m_pixels;
+
+    Rect m_view;
+
+    // columns that may still have dirt to slide
+    // and the lowest row to slide from (m_height when settled)
+    std::vector<int> m_unsettled;
+    std::vector<int> m_slide_start;
+
+    // the current slide, shared with the jobs
+    // and what each one changed
+    int m_slide_distance;
+    std::vector<Rect> m_slide_dirty;
+
+    // rows of fall owed to the unsettled columns
+    float m_fall;
+
+    // RGBA colors painted down from the top of each column
+    std::vector<Uint8> m_ramp;
+
+    // top solid row of each column
+    std::vector<int> m_tops;
+
+    unsigned int m_uploaded_bytes;
 
-    Vector3<float> m_last_deform_pos;
-    int m_last_deform_radius;
+    // changes() and what it was when each column last changed
+    unsigned int m_changes;
+    std::vector<unsigned int> m_changed;
 };
 
 
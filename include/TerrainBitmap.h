@@ -0,0 +1,154 @@
+/*
+====================
+File: TerrainBitmap.h
+Author: Shane Lillie
+Description: Bit-packed terrain bitmap header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+#if !defined TERRAINBITMAP_H
+#define TERRAINBITMAP_H
+
+
+#include <cassert>
+#include <vector>
+
+#include "SDL.h"
+
+
+/*
+ *  TerrainBitmap class
+ *
+ *  one bit per cell, stored column-major
+ *  each column is words_per_column() contiguous 64 bit words,
+ *  row y lives in bit (y % 64) of word (y / 64)
+ *
+ */
+
+
+class TerrainBitmap
+{
+public:
+    typedef Uint64 Word;
+
+    enum { WORD_BITS = 64, WORD_SHIFT = 6, WORD_MASK = 63 };
+
+public:
+    // number of set bits
+    static int popcount(Word word);
+
+    // index of the lowest/highest set bit
+    // the word must not be zero
+    static int lowest_bit(Word word);
+    static int highest_bit(Word word);
+
+    // mask with bits lo..hi (inclusive) set
+    static Word mask(int lo, int hi)
+    {
+        assert(lo >= 0 && lo <= hi && hi < WORD_BITS);
+
+        const Word all = ~static_cast<Word>(0);
+        return (all << lo) & (all >> (WORD_BITS - 1 - hi));
+    }
+
+public:
+    TerrainBitmap(int width, int height);
+
+public:
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int words_per_column() const { return m_words; }
+
+    // memory used by the bits
+    unsigned int bytes() const { return m_bits.size() * sizeof(Word); }
+
+    Word* column(int x)
+    {
+        assert(x >= 0 && x < m_width);
+        return &m_bits[x * m_words];
+    }
+
+    const Word* column(int x) const
+    {
+        assert(x >= 0 && x < m_width);
+        return &m_bits[x * m_words];
+    }
+
+    bool solid(int x, int y) const
+    {
+        assert(y >= 0 && y < m_height);
+        return (column(x)[y >> WORD_SHIFT] >> (y & WORD_MASK)) & 1;
+    }
+
+    void set(int x, int y)
+    {
+        assert(y >= 0 && y < m_height);
+        column(x)[y >> WORD_SHIFT] |= static_cast<Word>(1) << (y & WORD_MASK);
+    }
+
+    void clear(int x, int y)
+    {
+        assert(y >= 0 && y < m_height);
+        column(x)[y >> WORD_SHIFT] &= ~(static_cast<Word>(1) << (y & WORD_MASK));
+    }
+
+    // the WORD_BITS rows of a column from y up, row y in bit 0
+    // rows past the top are clear
+    Word window(int x, int y) const
+    {
+        assert(y >= 0);
+
+        const int w = y >> WORD_SHIFT, shift = y & WORD_MASK;
+        if(w >= m_words)
+            return 0;
+
+        const Word* const bits = column(x);
+        Word word = bits[w] >> shift;
+        if(shift && w + 1 < m_words)
+            word |= bits[w + 1] << (WORD_BITS - shift);
+        return word;
+    }
+
+public:
+    // span operations work on rows y0..y1 (inclusive) of one column
+    // spans are clipped to the bitmap height
+    void fill_span(int x, int y0, int y1);
+    void clear_span(int x, int y0, int y1);
+    bool any_span(int x, int y0, int y1) const;
+    int count_span(int x, int y0, int y1) const;
+
+    // highest/lowest solid row in the span, -1 if there isn't one
+    int top_span(int x, int y0, int y1) const;
+    int bottom_span(int x, int y0, int y1) const;
+
+    // highest solid row in the column, -1 if the column is empty
+    int top(int x) const { return top_span(x, 0, m_height - 1); }
+
+    // clears every cell
+    void reset();
+
+private:
+    int m_width, m_height;
+    int m_words;
+
+    std::vector<Word> m_bits;
+};
+
+
+#endif
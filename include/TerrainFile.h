@@ -0,0 +1,136 @@
+/*
+====================
+File: TerrainFile.h
+Author: Shane Lillie
+Description: Terrain file loading/conversion header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+#if !defined TERRAINFILE_H
+#define TERRAINFILE_H
+
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "SDL.h"
+#include "SDL_endian.h"
+
+#include "TerrainBitmap.h"
+
+
+/*
+ *  TerrainFile class
+ *
+ *  binary terrain (.stb) layout, little-endian:
+ *
+ *  Header          (see below)
+ *  Uint8[4] ramp   (ramp_size RGBA colors, top of a column down)
+ *  padding         (to bitmap_offset, 8 byte aligned)
+ *  Uint64 bitmap   (width * words_per_column words, TerrainBitmap layout)
+ *
+ *  the checksum is an adler-32 of everything after the header
+ *
+ */
+
+
+class TerrainFile
+{
+public:
+    class TerrainFileException : public std::exception
+    {
+    public:
+        TerrainFileException(const std::string& what) throw() : _what(what) { }
+        virtual ~TerrainFileException() throw() { }
+        virtual const char* what() const throw() { return _what.c_str(); }
+    private:
+        std::string _what;
+    };
+
+private:
+    struct Header
+    {
+        char magic[4];
+        Uint32 version;
+        Uint32 width, height;
+        Uint32 words_per_column;
+        Uint32 ramp_size;
+        Uint32 bitmap_offset;
+        Uint32 checksum;
+    };
+
+private:
+    static const char MAGIC[4];
+    static const Uint32 FILE_VERSION;
+
+public:
+    // the colors new terrain is painted with
+    static std::vector<Uint8> default_ramp();
+
+    // true if the file starts with the binary magic
+    static bool is_binary(const std::string& filename);
+
+    // parses the text .set format into bitmap
+    // (y, y,count and yrTop[,step] columns)
+    static void parse_set(const std::string& filename, TerrainBitmap& bitmap) throw(TerrainFileException);
+
+    // writes bitmap and ramp out in the binary format
+    static void write(const std::string& filename, const TerrainBitmap& bitmap, const std::vector<Uint8>& ramp) throw(TerrainFileException);
+
+    // converts a .set file to the binary format
+    static void convert(const std::string& set_filename, const std::string& filename, int width, int height) throw(TerrainFileException);
+
+public:
+    // maps a binary terrain file and validates it
+    TerrainFile(const std::string& filename) throw(TerrainFileException);
+    virtual ~TerrainFile();
+
+public:
+    int width() const { return SDL_SwapLE32(m_header->width); }
+    int height() const { return SDL_SwapLE32(m_header->height); }
+    int words_per_column() const { return SDL_SwapLE32(m_header->words_per_column); }
+
+    int ramp_size() const { return SDL_SwapLE32(m_header->ramp_size); }
+    const Uint8* ramp() const { return m_data + sizeof(Header); }
+
+    // copies the bitmap words straight into bitmap
+    // bitmap must be width() x height()
+    void copy_bitmap(TerrainBitmap& bitmap) const;
+
+private:
+    void unmap();
+
+private:
+    const Uint8* m_data;
+    unsigned int m_size;
+    const Header* m_header;
+
+#if defined WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+
+private:
+    TerrainFile(const TerrainFile&);
+    TerrainFile& operator=(const TerrainFile&);
+};
+
+
+#endif
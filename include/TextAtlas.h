@@ -0,0 +1,100 @@
+/*
+====================
+File: TextAtlas.h
+Author: Shane Lillie
+Description: Glyph atlas text renderer header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+#if !defined TEXTATLAS_H
+#define TEXTATLAS_H
+
+
+#include <string>
+#include <vector>
+
+#include "LogicalFont.h"
+
+
+/*
+ *  TextAtlas class
+ *
+ *  rasterizes the printable ASCII glyphs of a font once
+ *  into a single texture, then draws strings as quads out of it
+ *  strings are queued up by draw() and go out in one call from flush()
+ *
+ */
+
+
+class TextAtlas
+{
+private:
+    enum { FIRST_GLYPH = 32, LAST_GLYPH = 126 };
+
+    struct Glyph
+    {
+        int x, y;           // top left in the atlas
+        int width, height;  // advance and line height
+    };
+
+private:
+    static const int ATLAS_WIDTH;
+
+public:
+    // the font has to outlive the atlas
+    explicit TextAtlas(const LogicalFont& font);
+    virtual ~TextAtlas();
+
+public:
+    bool valid() const { return m_font.valid(); }
+    int height() const { return m_font.height(); }
+
+    // width of a string in pixels
+    int width(const char* text);
+
+    // queues text with its bottom left corner at x, y
+    void draw(const char* text, int x, int y);
+
+    // draws everything queued with the current color
+    void flush();
+
+private:
+    // rasterizes the glyphs and uploads the atlas
+    // needs a GL context
+    bool build();
+
+private:
+    const LogicalFont& m_font;
+
+    Glyph m_glyphs[LAST_GLYPH - FIRST_GLYPH + 1];
+    int m_atlas_height;
+    unsigned int m_texture;
+    bool m_built;
+
+    // reused every frame, so queuing text doesn't allocate
+    // once they've grown to fit
+    std::vector<float> m_vertices, m_texcoords;
+
+private:
+    TextAtlas(const TextAtlas&);
+    TextAtlas& operator=(const TextAtlas&);
+};
+
+
+#endif
@@ -0,0 +1,97 @@
+/*
+====================
+File: TextureCache.h
+Author: Shane Lillie
+Description: Texture cache header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+#if !defined TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+
+#include <string>
+
+#include "SDL.h"
+#include "SDL_opengl.h"
+
+
+/*
+ *  TextureCache class
+ *
+ *  every GL texture made from an image goes through here,
+ *  keyed by name (or surface id), so anything asking for the same
+ *  image gets the same texture instead of uploading it again
+ *
+ *  textures are reference counted, but an unreferenced texture
+ *  stays resident until purge() so the next user doesn't re-upload it
+ *  (the sprites purge after they rebuild, and the game before it
+ *  shuts down so the dump only shows what's still held)
+ *
+ */
+
+
+class TextureCache
+{
+public:
+    struct Stats
+    {
+        int resident;           // textures on the card
+        int referenced;         // ones somebody is still using
+        unsigned int bytes;     // size of the resident textures
+        int hits, uploads;      // acquires that found a texture / uploads
+        unsigned int uploaded;  // bytes uploaded
+    };
+
+public:
+    // the name the texture of a surface is cached under
+    static std::string surface_name(int surface);
+
+    // adds a reference to a cached texture, 0 if it isn't cached
+    static unsigned int acquire(const std::string& name);
+
+    // adds a reference to the texture of a surface,
+    // uploading it the first time
+    static unsigned int acquire(int surface);
+
+    // uploads width x height pixels under name and adds a reference
+    // GL_BGR and GL_BGRA pixels are converted to RGBA once, here
+    // a cached texture with the same name is reused and overwritten
+    static unsigned int create(const std::string& name, int width, int height, GLenum format, const void* pixels);
+
+    // drops a reference, the texture stays resident
+    static void release(unsigned int texture);
+
+    // deletes every texture nothing references
+    static void purge();
+
+    // deletes everything, for when the GL context goes away
+    static void clear();
+
+    static Stats stats();
+
+    // logs every texture and the totals
+    static void dump();
+
+private:
+    TextureCache();
+};
+
+
+#endif
@@ -0,0 +1,107 @@
+/*
+====================
+File: Timeline.h
+Author: Shane Lillie
+Description: Trace event timeline header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#if !defined TIMELINE_H
+#define TIMELINE_H
+
+
+#include <string>
+
+
+/*
+ *  Timeline class
+ *
+ *  records spans, counters and object lifetimes while a capture
+ *  is running and writes them out as Chrome trace event JSON
+ *  (chrome://tracing or ui.perfetto.dev)
+ *
+ *  events go into a preallocated buffer that's only written to
+ *  the file between frames (or when the capture stops), so
+ *  recording costs a clock read and a store
+ *
+ *  everything is recorded from the main thread, so nothing
+ *  here is locked
+ *
+ */
+
+
+class Timeline
+{
+public:
+    // records a span for as long as it's in scope
+    class Span
+    {
+    public:
+        explicit Span(const char* name);
+        ~Span();
+
+    private:
+        const char* m_name;
+        double m_start;
+
+    private:
+        Span(const Span&);
+        Span& operator=(const Span&);
+    };
+
+public:
+    // events buffered before they're dropped
+    static const int MAX_EVENTS;
+
+    // buffered events that get written out at the end of a frame
+    static const int FLUSH_EVENTS;
+
+public:
+    // starts recording into filename, false if it can't be written
+    static bool start(const std::string& filename);
+
+    // writes out what's left and closes the file
+    static void stop();
+
+    static bool recording();
+
+    // names have to be string literals (or live as long as the capture)
+    // times are FrameTimer::now() microseconds
+    static void span(const char* name, double start, double end);
+    static void counter(const char* name, double value);
+
+    // an object that lives across frames, begin returns
+    // the id to end it with
+    static int begin_object(const char* name);
+    static void end_object(const char* name, int id);
+
+    // writes out the buffer if it's getting full,
+    // call between frames
+    static void end_frame();
+
+private:
+    static void flush();
+
+private:
+    Timeline();
+};
+
+
+#endif
@@ -0,0 +1,115 @@
+/*
+====================
+File: Trace.h
+Author: Shane Lillie
+Description: Function trace header
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#if !defined TRACE_H
+#define TRACE_H
+
+
+#include <iostream>
+
+
+/*
+ *  constants
+ *
+ */
+
+
+// tracing is compiled into debug builds (and anything built
+// with -DTRACE_ENABLED), in release TRACE_FUNCTION is nothing
+#if !defined NDEBUG && !defined TRACE_ENABLED
+    #define TRACE_ENABLED
+#endif
+
+
+/*
+ *  macros
+ *
+ */
+
+
+#if defined TRACE_ENABLED
+    #define TRACE_FUNCTION(f) Trace::Scope trace_function_(#f)
+#else
+    #define TRACE_FUNCTION(f)
+#endif
+
+
+/*
+ *  Trace class
+ *
+ *  every thread records the functions it enters into a ring buffer
+ *  of its own, so entering a function is a couple of stores and
+ *  nothing is shared or locked between threads
+ *
+ *  dump() prints the last entries of every thread, and only reads
+ *  the rings, so it's safe enough to call from a signal handler
+ *
+ */
+
+
+class Trace
+{
+public:
+    // records a function for as long as it's in scope
+    class Scope
+    {
+    public:
+        explicit Scope(const char* function)
+        {
+            Trace::enter(function);
+        }
+
+        ~Scope()
+        {
+            Trace::leave();
+        }
+
+    private:
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+    };
+
+public:
+    // entries kept per thread
+    static const int RING_SIZE;
+
+    // threads that get a ring, any after that aren't traced
+    static const int MAX_THREADS;
+
+public:
+    // function has to be a string literal (or live as long)
+    static void enter(const char* function);
+    static void leave();
+
+    // writes the last count entries of each thread, oldest first,
+    // indented by how deep the call was
+    static void dump(std::ostream& out, int count);
+
+private:
+    Trace();
+};
+
+
+#endif
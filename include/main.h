@@ -47,5 +47,9 @@ Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 // the no-image image file name
 #define NOIMAGE "/images/noimage" NOIMAGE_EXTENSION
 
+// window (and terrain) size
+#define DEFAULT_WIDTH 800
+#define DEFAULT_HEIGHT 600
+
 
 #endif
@@ -23,182 +23,319 @@ Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
-#include <cstdlib>
 
 #include "SDL_opengl.h"
 
 #include "DirtParticle.h"
+#include "Random.h"
 #include "Terrain.h"
-#include "Engine.h"
-#include "Callstack.h"
+#include "JobPool.h"
+#include "TextureCache.h"
+#include "Timeline.h"
 
 
 /*
- *  DirtParticle methods
+ *  DirtParticleSystem class constants
  *
  */
 
 
-DirtParticleSystem::DirtParticle::DirtParticle(const Vector3<float>& position, const Vector3<float>& velocity, unsigned int texture)
-    : Particle(position, velocity),
-        m_texture(texture)
-{
-    m_lifetime = INFINITE_LIFETIME;
+const int DirtParticleSystem::PARTICLE_WIDTH = 2;
+const int DirtParticleSystem::PARTICLE_HEIGHT = 2;
+const int DirtParticleSystem::MAX_PARTICLES = 500;
+const int DirtParticleSystem::UPDATE_GRAIN = 64;
 
-    m_width = PARTICLE_WIDTH;
-    m_height = PARTICLE_HEIGHT;
-}
+
+/*
+ *  DirtParticleSystem methods
+ *
+ */
 
 
-void DirtParticleSystem::DirtParticle::on_update(World* const world, float elapsed_sec, const Particle* const head)
+DirtParticleSystem::DirtParticleSystem(const Vector3<float>& origin, float force, float angle, Random& random)
+    : m_origin(origin), m_force(force), m_angle(angle), m_random(&random), m_alpha(1.0f),
+        m_pool(MAX_PARTICLES * 8, 0.0f), m_landed(MAX_PARTICLES, Flying), m_count(0),
+        m_terrain(NULL), m_elapsed_sec(0.0f), m_texture(0),
+        m_timeline_id(Timeline::begin_object("dirt particles"))
 {
-    /* -190 is gravity */
-    Vector3<float> vavg(m_velocity.x(), m_velocity.y() + ((-190.0f / 2.0f) * elapsed_sec), m_velocity.z());
-    Vector3<float> pos(m_position + (vavg * elapsed_sec));
+    Vector2<float> v;
+    v.construct(force, angle);
+    m_initial_velocity = v.vec3();
 
-    m_velocity.y(m_velocity.y() + (-190.0f * elapsed_sec));
+    m_x = &m_pool[0];
+    m_y = m_x + MAX_PARTICLES;
+    m_prev_x = m_y + MAX_PARTICLES;
+    m_prev_y = m_prev_x + MAX_PARTICLES;
+    m_vx = m_prev_y + MAX_PARTICLES;
+    m_vy = m_vx + MAX_PARTICLES;
+    m_next_x = m_vy + MAX_PARTICLES;
+    m_next_y = m_next_x + MAX_PARTICLES;
+
+    // the texture is fetched by the first render
+    // so the system can run without a GL context
+}
 
-    m_prev_position = m_position;
 
-    if(world->collision(m_position, pos, vavg, NULL, static_cast<int>(m_width), static_cast<int>(m_height)))
-        kill();
-    else
-        m_position = pos;
+DirtParticleSystem::~DirtParticleSystem()
+{
+    Timeline::end_object("dirt particles", m_timeline_id);
+    release_texture();
 }
 
 
-void DirtParticleSystem::DirtParticle::on_render(int window_width, int window_height) const
+void DirtParticleSystem::emit_max()
 {
-    if(is_dead())
-        return;
+    for(; m_count<MAX_PARTICLES; ++m_count) {
+        // fuzz the velocity a bit
+        m_vy[m_count] = /*m_initial_velocity.y()*/ m_initial_velocity.length() + m_random->range(50) - 25.0f;
+        m_vx[m_count] = /*m_initial_velocity.x() +*/ m_random->range(50) - 25.0f;
+
+        // fuzz the origin a bit
+        m_x[m_count] = m_prev_x[m_count] = m_origin.x() + m_random->range(24) - 12.0f;
+        m_y[m_count] = m_prev_y[m_count] = m_origin.y() + m_random->range(24) - 12.0f;
+    }
+}
 
-    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
-    if(depth_test)
-        glDisable(GL_DEPTH_TEST);
 
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-        glLoadIdentity();
+void DirtParticleSystem::update(Terrain* const terrain, float elapsed_sec, JobPool* const jobs)
+{
+    m_terrain = terrain;
+    m_elapsed_sec = elapsed_sec;
 
-        gluOrtho2D(0.0f, window_width, 0.0f, window_height);
+    // the chunks only read the terrain,
+    // so they can run on any thread
+    if(jobs)
+        jobs->parallel_for(update_particles, this, m_count, UPDATE_GRAIN);
+    else
+        update_particles(this, 0, m_count);
 
-        glMatrixMode(GL_MODELVIEW);
-        glPushMatrix();
-            glLoadIdentity();
+    land(terrain);
+}
 
-            glTranslatef(m_position.x(), m_position.y(), m_position.z());
 
-            glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(m_texture));
+void DirtParticleSystem::update_all(const std::vector<DirtParticleSystem*>& systems, Terrain* const terrain, float elapsed_sec, JobPool* const jobs)
+{
+    // reused every step, so this doesn't allocate
+    // once it's grown to fit
+    static std::vector<Chunk> chunks;
+    chunks.clear();
+
+    for(std::vector<DirtParticleSystem*>::const_iterator it = systems.begin(); it != systems.end(); ++it) {
+        DirtParticleSystem* const system = *it;
+        system->m_terrain = terrain;
+        system->m_elapsed_sec = elapsed_sec;
+
+        for(int begin=0; begin<system->m_count; begin += UPDATE_GRAIN) {
+            Chunk chunk;
+            chunk.system = system;
+            chunk.begin = begin;
+            chunk.end = std::min(begin + UPDATE_GRAIN, system->m_count);
+            chunks.push_back(chunk);
+        }
+    }
+
+    // one wait for all of them instead of one per system
+    if(jobs)
+        jobs->parallel_for(update_chunks, &chunks, chunks.size(), 1);
+    else
+        update_chunks(&chunks, 0, chunks.size());
 
-/* FIXME: move most of this shit out into the system to make rendering faster */
-            glBegin(GL_QUADS);
-                glNormal3f(0.0f, 0.0f, 1.0f);
-                glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, 0.0f);
-                glTexCoord2f(1.0f, 0.0f); glVertex2f(m_width, 0.0f);
-                glTexCoord2f(1.0f, 1.0f); glVertex2f(m_width, m_height);
-                glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, m_height);
-            glEnd();
+    // landing changes the terrain, so that's one system at a time
+    for(std::vector<DirtParticleSystem*>::const_iterator it = systems.begin(); it != systems.end(); ++it)
+        (*it)->land(terrain);
+}
 
-        glPopMatrix();
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
 
-    if(depth_test)
-        glEnable(GL_DEPTH_TEST);
+void DirtParticleSystem::land(Terrain* const terrain)
+{
+    // land the ones that hit, back to front so
+    // the particles swapped down have already been done
+    for(int i=m_count-1; i>=0; --i) {
+        if(m_landed[i] == Flying)
+            continue;
+
+        if(m_landed[i] == Landed)
+            terrain->deposit(Vector3<float>(m_next_x[i], m_next_y[i], m_origin.z()), PARTICLE_WIDTH, PARTICLE_HEIGHT);
+        kill(i);
+    }
+
+    m_terrain = NULL;
 }
 
 
-/*
- *  DirtParticleSystem class constants
- *
- */
+void DirtParticleSystem::update_chunks(void* data, int begin, int end)
+{
+    const std::vector<Chunk>& chunks = *static_cast<const std::vector<Chunk>*>(data);
+    for(int i=begin; i<end; ++i)
+        update_particles(chunks[i].system, chunks[i].begin, chunks[i].end);
+}
 
 
-const int DirtParticleSystem::PARTICLE_WIDTH = 2;
-const int DirtParticleSystem::PARTICLE_HEIGHT = 2;
-const int DirtParticleSystem::MAX_PARTICLES = 500;
+void DirtParticleSystem::update_particles(void* data, int begin, int end)
+{
+    DirtParticleSystem* const system = static_cast<DirtParticleSystem*>(data);
+    const Terrain* const terrain = system->m_terrain;
+    const float elapsed_sec = system->m_elapsed_sec;
 
+    float* const x = system->m_x;
+    float* const y = system->m_y;
+    float* const vx = system->m_vx;
+    float* const vy = system->m_vy;
+    float* const next_x = system->m_next_x;
+    float* const next_y = system->m_next_y;
 
-/*
- *  DirtParticleSystem methods
- *
- */
+    /* -190 is gravity */
+    const float half_dv = (-190.0f / 2.0f) * elapsed_sec;
+    const float dv = -190.0f * elapsed_sec;
+
+    // integrate the chunk in one pass, nothing in here branches
+    for(int i=begin; i<end; ++i) {
+        next_x[i] = x[i] + (vx[i] * elapsed_sec);
+        next_y[i] = y[i] + ((vy[i] + half_dv) * elapsed_sec);
+        vy[i] += dv;
+    }
+
+    // then test the moves against the terrain,
+    // almost all of them are above ground and only cost a few compares
+    for(int i=begin; i<end; ++i) {
+        const Vector3<float> pos(x[i], y[i], system->m_origin.z());
+        const Vector3<float> next(next_x[i], next_y[i], system->m_origin.z());
+
+        // the velocity is only used to back out of the ground,
+        // and that's the average over the step
+        const Vector3<float> vavg(vx[i], vy[i] - half_dv, 0.0f);
+
+        Vector3<float> rest;
+        if(terrain->collision(pos, next, vavg, &rest, PARTICLE_WIDTH, PARTICLE_HEIGHT)) {
+            // dirt that flew off the sides is gone,
+            // anything else lands where it stopped
+            if(next.x() >= 0.0f && next.x() + PARTICLE_WIDTH < terrain->width()) {
+                system->m_landed[i] = Landed;
+                next_x[i] = rest.x();
+                next_y[i] = rest.y();
+            } else
+                system->m_landed[i] = Lost;
+            continue;
+        }
+
+        system->m_landed[i] = Flying;
+        system->m_prev_x[i] = x[i];
+        system->m_prev_y[i] = y[i];
+        x[i] = next_x[i];
+        y[i] = next_y[i];
+    }
+}
 
 
-DirtParticleSystem::DirtParticleSystem(const Vector3<float>& origin, float force, float angle)
-    : ParticleSystem(MAX_PARTICLES, origin),
-        m_force(force), m_angle(angle), m_texture(0)
+void DirtParticleSystem::render(int view_x, int view_y, int width, int height) const
 {
-    Vector2<float> v;
-    v.construct(force, angle);
-    m_initial_velocity = v.vec3();
+    if(!m_count)
+        return;
 
-    create_texture();
-}
+    if(!m_texture)
+        create_texture();
 
+    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    if(depth_test)
+        glDisable(GL_DEPTH_TEST);
 
-DirtParticleSystem::~DirtParticleSystem()
-{
-    delete_texture();
-}
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+        glLoadIdentity();
 
+        gluOrtho2D(view_x, view_x + width, view_y, view_y + height);
 
-void DirtParticleSystem::create_texture()
-{
-    if(m_texture)
-        delete_texture();
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+            glLoadIdentity();
 
-    int surface = Engine::create_surface(PARTICLE_WIDTH, PARTICLE_HEIGHT, 32, "dirt_particle");
-    if(surface < 0) return;
+            glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(m_texture));
+            glNormal3f(0.0f, 0.0f, 1.0f);
 
-    Engine::lock_surface(surface);
+            // one quad per particle, all drawn at once
+            GLfloat* vertex = &m_vertices[0];
+            for(int i=0; i<m_count; ++i) {
+                const GLfloat x = m_prev_x[i] + ((m_x[i] - m_prev_x[i]) * m_alpha);
+                const GLfloat y = m_prev_y[i] + ((m_y[i] - m_prev_y[i]) * m_alpha);
 
-        for(int x=0; x<PARTICLE_WIDTH; ++x)
-            for(int y=0; y<PARTICLE_HEIGHT; ++y)
-                Engine::pixel(surface, x, y, Engine::map_rgba(surface, 0, 192, 6, 255));
+                *vertex++ = x;                  *vertex++ = y;
+                *vertex++ = x + PARTICLE_WIDTH; *vertex++ = y;
+                *vertex++ = x + PARTICLE_WIDTH; *vertex++ = y + PARTICLE_HEIGHT;
+                *vertex++ = x;                  *vertex++ = y + PARTICLE_HEIGHT;
+            }
 
-    Engine::unlock_surface(surface);
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
-    glGenTextures(1, &m_texture);
-    glBindTexture(GL_TEXTURE_2D, m_texture);
+            glVertexPointer(2, GL_FLOAT, 0, &m_vertices[0]);
+            glTexCoordPointer(2, GL_FLOAT, 0, &m_texcoords[0]);
+            glDrawArrays(GL_QUADS, 0, m_count * 4);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+            glDisableClientState(GL_VERTEX_ARRAY);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, PARTICLE_WIDTH, PARTICLE_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, Engine::surface_pixels(surface));
+        glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
 
-    Engine::unload_surface(surface);
+    if(depth_test)
+        glEnable(GL_DEPTH_TEST);
 }
 
 
-void DirtParticleSystem::delete_texture()
+void DirtParticleSystem::create_texture() const
 {
+    assert(!m_texture);
+
+    // the texture coordinates are the same for every particle
+    m_vertices.resize(MAX_PARTICLES * 8);
+    m_texcoords.resize(MAX_PARTICLES * 8);
+    for(int i=0; i<MAX_PARTICLES; ++i) {
+        GLfloat* const texcoord = &m_texcoords[i * 8];
+        texcoord[0] = 0.0f; texcoord[1] = 0.0f;
+        texcoord[2] = 1.0f; texcoord[3] = 0.0f;
+        texcoord[4] = 1.0f; texcoord[5] = 1.0f;
+        texcoord[6] = 0.0f; texcoord[7] = 1.0f;
+    }
+
+    // every impact shares the one texture
+    m_texture = TextureCache::acquire("dirt particle");
     if(m_texture)
-        glDeleteTextures(1, &m_texture);
-    m_texture = 0;
+        return;
+
+    std::vector<Uint8> pixels(PARTICLE_WIDTH * PARTICLE_HEIGHT * 4);
+    for(int i=0; i<PARTICLE_WIDTH * PARTICLE_HEIGHT; ++i) {
+        pixels[(i * 4) + 0] = 0;
+        pixels[(i * 4) + 1] = 192;
+        pixels[(i * 4) + 2] = 6;
+        pixels[(i * 4) + 3] = 255;
+    }
+
+    m_texture = TextureCache::create("dirt particle", PARTICLE_WIDTH, PARTICLE_HEIGHT, GL_RGBA, &pixels[0]);
 }
 
 
-Particle* const DirtParticleSystem::on_add() const
+void DirtParticleSystem::release_texture()
 {
-    // fuzz the velocity a bit
-    Vector3<float> vel;
-    vel.y(/*m_initial_velocity.y()*/ m_initial_velocity.length() + (rand() % 50) - 25.0f);
-    vel.x(/*m_initial_velocity.x() +*/ (rand() % 50) - 25.0f);
-    vel.z(m_initial_velocity.z());
-
-    // fuzz the origin a bit
-    Vector3<float> orig(origin());
-    orig.x(orig.x() + (rand() % 24) - 12.0f);
-    orig.y(orig.y() + (rand() % 24) - 12.0f);
-
-    return new DirtParticle(orig, vel, m_texture);
+    TextureCache::release(m_texture);
+    m_texture = 0;
 }
 
 
-void DirtParticleSystem::on_render(const Particle* const particle, int window_width, int window_height) const
+void DirtParticleSystem::kill(int i)
 {
-    particle->render(window_width, window_height);
+    assert(i >= 0 && i < m_count);
+
+    const int last = --m_count;
+    m_x[i] = m_x[last];
+    m_y[i] = m_y[last];
+    m_prev_x[i] = m_prev_x[last];
+    m_prev_y[i] = m_prev_y[last];
+    m_vx[i] = m_vx[last];
+    m_vy[i] = m_vy[last];
+    m_next_x[i] = m_next_x[last];
+    m_next_y[i] = m_next_y[last];
 }
@@ -0,0 +1,250 @@
+/*
+====================
+File: Entities.cc
+Author: Shane Lillie
+Description: Projectile and effect store source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+
+#include <cassert>
+
+#include "Entities.h"
+#include "DirtParticle.h"
+#include "Random.h"
+#include "SpriteMask.h"
+#include "Terrain.h"
+
+
+/*
+ *  constants
+ *
+ */
+
+
+const Vector3<float> SMOKE_VELOCITY(0.0f, 25.0f, 0.0f);
+
+
+/*
+ *  Entities class constants
+ *
+ */
+
+
+const int Entities::SPLIT_SPREAD = 40;
+
+
+/*
+ *  Entities methods
+ *
+ */
+
+
+Entities::Entities()
+{
+}
+
+
+Entities::~Entities()
+{
+    clear();
+}
+
+
+void Entities::add_projectile(const Vector3<float>& pos, const Vector3<float>& vel, int warheads)
+{
+    m_x.push_back(pos.x());
+    m_y.push_back(pos.y());
+    m_prev_x.push_back(pos.x());
+    m_prev_y.push_back(pos.y());
+    m_vx.push_back(vel.x());
+    m_vy.push_back(vel.y());
+    m_warheads.push_back(warheads);
+}
+
+
+void Entities::add_burst(const Impact& impact, const Vector3<float>& pos, Random& random)
+{
+    DirtParticleSystem* const dirt = new DirtParticleSystem(pos, impact.vel.length() / -2.0f, impact.vel.vec2().angle(), random);
+    dirt->emit_max();
+    m_dirt.push_back(dirt);
+
+    m_smoke.push_back(impact.pos);
+    m_smoke_prev.push_back(impact.pos);
+}
+
+
+void Entities::update_projectiles(const Terrain& terrain, const SpriteMask& mask, float elapsed_sec, Random& random, std::vector<Impact>& impacts)
+{
+    /* -190 is gravity */
+    const float half_dv = (-190.0f / 2.0f) * elapsed_sec;
+    const float dv = -190.0f * elapsed_sec;
+
+    // back to front, so a removed projectile only swaps
+    // down one that's already been moved
+    // (and warheads split off here don't move until the next step)
+    for(int i=m_x.size()-1; i>=0; --i) {
+        const Vector3<float> pos(m_x[i], m_y[i], 0.0f);
+        const Vector3<float> vavg(m_vx[i], m_vy[i] + half_dv, 0.0f);
+        const Vector3<float> next(pos + (vavg * elapsed_sec));
+
+        m_prev_x[i] = m_x[i];
+        m_prev_y[i] = m_y[i];
+        m_vy[i] += dv;
+
+        Impact impact;
+        if(terrain.collision(pos, next, vavg, &impact.pos, mask)) {
+            impact.vel = Vector3<float>(m_vx[i], m_vy[i], 0.0f);
+            impacts.push_back(impact);
+
+            remove_projectile(i);
+            continue;
+        }
+
+        m_x[i] = next.x();
+        m_y[i] = next.y();
+
+        // split at the top of the arc, this one becomes the first warhead
+        if(m_warheads[i] > 0 && m_vy[i] <= 0.0f) {
+            const Vector3<float> at(m_x[i], m_y[i], 0.0f);
+            for(int j=1; j<m_warheads[i]; ++j) {
+                const Vector3<float> vel(m_vx[i] + random.range(-SPLIT_SPREAD, SPLIT_SPREAD), m_vy[i] + random.range(-SPLIT_SPREAD, SPLIT_SPREAD), 0.0f);
+                add_projectile(at, vel);
+
+                // the warhead starts where this one was a step ago,
+                // so it doesn't jump when it's drawn
+                m_prev_x.back() = m_prev_x[i];
+                m_prev_y.back() = m_prev_y[i];
+            }
+            m_warheads[i] = 0;
+        }
+    }
+}
+
+
+void Entities::update_bursts(Terrain* const terrain, float elapsed_sec, JobPool* const jobs)
+{
+    if(m_dirt.empty())
+        return;
+
+    DirtParticleSystem::update_all(m_dirt, terrain, elapsed_sec, jobs);
+
+    for(unsigned int i=0; i<m_smoke.size(); ++i) {
+        m_smoke_prev[i] = m_smoke[i];
+        m_smoke[i] = m_smoke[i] + (SMOKE_VELOCITY * elapsed_sec);
+    }
+
+    // the dirt that landed may still be sliding
+    if(!terrain->settled())
+        return;
+
+    for(int i=m_dirt.size()-1; i>=0; --i) {
+        if(!m_dirt[i]->finished())
+            continue;
+
+        delete m_dirt[i];
+
+        m_dirt[i] = m_dirt.back();
+        m_smoke[i] = m_smoke.back();
+        m_smoke_prev[i] = m_smoke_prev.back();
+
+        m_dirt.pop_back();
+        m_smoke.pop_back();
+        m_smoke_prev.pop_back();
+    }
+}
+
+
+void Entities::clear()
+{
+    m_x.clear();
+    m_y.clear();
+    m_prev_x.clear();
+    m_prev_y.clear();
+    m_vx.clear();
+    m_vy.clear();
+    m_warheads.clear();
+
+    for(std::vector<DirtParticleSystem*>::iterator it = m_dirt.begin(); it != m_dirt.end(); ++it)
+        delete *it;
+
+    m_dirt.clear();
+    m_smoke.clear();
+    m_smoke_prev.clear();
+}
+
+
+int Entities::particles() const
+{
+    int count = 0;
+    for(std::vector<DirtParticleSystem*>::const_iterator it = m_dirt.begin(); it != m_dirt.end(); ++it)
+        count += (*it)->count();
+    return count;
+}
+
+
+Vector3<float> Entities::projectile(int i, float alpha) const
+{
+    assert(i >= 0 && i < projectiles());
+    return Vector3<float>(m_prev_x[i] + ((m_x[i] - m_prev_x[i]) * alpha), m_prev_y[i] + ((m_y[i] - m_prev_y[i]) * alpha), 0.0f);
+}
+
+
+Vector3<float> Entities::projectile_velocity(int i) const
+{
+    assert(i >= 0 && i < projectiles());
+    return Vector3<float>(m_vx[i], m_vy[i], 0.0f);
+}
+
+
+Vector3<float> Entities::smoke(int i, float alpha) const
+{
+    assert(i >= 0 && i < bursts());
+    return m_smoke_prev[i] + ((m_smoke[i] - m_smoke_prev[i]) * alpha);
+}
+
+
+void Entities::render(float alpha, int x, int y, int width, int height) const
+{
+    for(std::vector<DirtParticleSystem*>::const_iterator it = m_dirt.begin(); it != m_dirt.end(); ++it) {
+        (*it)->set_alpha(alpha);
+        (*it)->render(x, y, width, height);
+    }
+}
+
+
+void Entities::remove_projectile(int i)
+{
+    m_x[i] = m_x.back();
+    m_y[i] = m_y.back();
+    m_prev_x[i] = m_prev_x.back();
+    m_prev_y[i] = m_prev_y.back();
+    m_vx[i] = m_vx.back();
+    m_vy[i] = m_vy.back();
+    m_warheads[i] = m_warheads.back();
+
+    m_x.pop_back();
+    m_y.pop_back();
+    m_prev_x.pop_back();
+    m_prev_y.pop_back();
+    m_vx.pop_back();
+    m_vy.pop_back();
+    m_warheads.pop_back();
+}
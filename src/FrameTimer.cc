@@ -0,0 +1,180 @@
+/*
+====================
+File: FrameTimer.cc
+Author: Shane Lillie
+Description: Per-frame phase timing source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#include "FrameTimer.h"
+#include "SEarth.h"
+
+
+/*
+ *  constants
+ *
+ */
+
+
+const char* const PHASE_NAMES[FrameTimer::PhaseCount] = {
+    "background",
+    "terrain render",
+    "sprites",
+    "particle render",
+    "hud",
+    "flip",
+    "tank physics",
+    "particle update",
+    "slide",
+    "projectile",
+    "frame"
+};
+
+
+/*
+ *  FrameTimer class constants
+ *
+ */
+
+
+const int FrameTimer::FRAMES = 1024;
+
+
+/*
+ *  FrameTimer functions
+ *
+ */
+
+
+double FrameTimer::now()
+{
+#if defined WIN32
+    static LARGE_INTEGER frequency = { 0 };
+    if(!frequency.QuadPart)
+        QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER count;
+    QueryPerformanceCounter(&count);
+    return (static_cast<double>(count.QuadPart) * 1000000.0) / static_cast<double>(frequency.QuadPart);
+#else
+    // monotonic, so setting the clock can't make time jump
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (static_cast<double>(ts.tv_sec) * 1000000.0) + (ts.tv_nsec / 1000.0);
+#endif
+}
+
+
+const char* FrameTimer::name(Phase phase)
+{
+    assert(phase >= 0 && phase < PhaseCount);
+    return PHASE_NAMES[phase];
+}
+
+
+/*
+ *  FrameTimer methods
+ *
+ */
+
+
+FrameTimer::FrameTimer()
+    : m_samples(FRAMES * PhaseCount, 0.0f), m_next(0), m_count(0), m_frame_start(0.0), m_in_frame(false)
+{
+    std::memset(m_current, 0, sizeof(m_current));
+}
+
+
+void FrameTimer::begin_frame()
+{
+    std::memset(m_current, 0, sizeof(m_current));
+    m_frame_start = now();
+    m_in_frame = true;
+}
+
+
+void FrameTimer::end_frame()
+{
+    if(!m_in_frame)
+        return;
+
+    const double end = now();
+    m_current[Frame] = static_cast<float>(end - m_frame_start);
+    m_in_frame = false;
+
+    Timeline::span(name(Frame), m_frame_start, end);
+
+    std::memcpy(&m_samples[m_next * PhaseCount], m_current, sizeof(m_current));
+
+    m_next = (m_next + 1) % FRAMES;
+    m_count = std::min(m_count + 1, FRAMES);
+}
+
+
+float FrameTimer::last(Phase phase) const
+{
+    if(!m_count)
+        return 0.0f;
+
+    const int frame = (m_next + FRAMES - 1) % FRAMES;
+    return m_samples[(frame * PhaseCount) + phase];
+}
+
+
+float FrameTimer::percentile(Phase phase, int p) const
+{
+    if(!m_count)
+        return 0.0f;
+
+    // the ring order doesn't matter here
+    m_sorted.resize(m_count);
+    for(int i=0; i<m_count; ++i)
+        m_sorted[i] = m_samples[(i * PhaseCount) + phase];
+
+    // nearest rank
+    const int rank = std::max(static_cast<int>(std::ceil((p / 100.0) * m_count)) - 1, 0);
+    std::nth_element(m_sorted.begin(), m_sorted.begin() + rank, m_sorted.end());
+    return m_sorted[rank];
+}
+
+
+void FrameTimer::log() const
+{
+    if(!m_count)
+        return;
+
+    SEarth::log("Phase timings over the last %d frames (p50/p95/p99 ms):\n", m_count);
+    for(int i=0; i<PhaseCount; ++i) {
+        const Phase phase = static_cast<Phase>(i);
+        SEarth::log("    %-16s %7.3f %7.3f %7.3f\n", name(phase),
+            percentile(phase, 50) / 1000.0f, percentile(phase, 95) / 1000.0f, percentile(phase, 99) / 1000.0f);
+    }
+}
@@ -0,0 +1,223 @@
+/*
+====================
+File: JobPool.cc
+Author: Shane Lillie
+Description: Work-stealing job pool source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#include <cassert>
+
+#if defined WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
+#include "JobPool.h"
+
+
+/*
+ *  JobPool functions
+ *
+ */
+
+
+int JobPool::cpu_count()
+{
+#if defined WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#elif defined _SC_NPROCESSORS_ONLN
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? static_cast<int>(count) : 1;
+#else
+    return 1;
+#endif
+}
+
+
+int JobPool::worker_main(void* data)
+{
+    Worker* const worker = static_cast<Worker*>(data);
+    JobPool* const pool = worker->pool;
+
+    while(true) {
+        Job job;
+        if(pool->pop(worker->index, job)) {
+            pool->run(job);
+            continue;
+        }
+
+        // nothing to take, sleep until there is
+        SDL_mutexP(pool->m_lock);
+        while(!pool->m_quit && pool->m_queued <= 0)
+            SDL_CondWait(pool->m_wake, pool->m_lock);
+        const bool quit = pool->m_quit;
+        SDL_mutexV(pool->m_lock);
+
+        if(quit)
+            break;
+    }
+    return 0;
+}
+
+
+/*
+ *  JobPool methods
+ *
+ */
+
+
+JobPool::JobPool(int threads)
+    : m_queues(threads > 0 ? threads : 1), m_workers(m_queues.size() - 1),
+        m_lock(SDL_CreateMutex()), m_wake(SDL_CreateCond()), m_done(SDL_CreateCond()),
+        m_queued(0), m_pending(0), m_quit(false)
+{
+    for(unsigned int i=0; i<m_queues.size(); ++i)
+        m_queues[i].lock = SDL_CreateMutex();
+
+    // queue 0 belongs to the thread calling parallel_for
+    for(unsigned int i=0; i<m_workers.size(); ++i) {
+        m_workers[i].pool = this;
+        m_workers[i].index = i + 1;
+        m_workers[i].thread = SDL_CreateThread(worker_main, &m_workers[i]);
+    }
+}
+
+
+JobPool::~JobPool()
+{
+    SDL_mutexP(m_lock);
+    m_quit = true;
+    SDL_CondBroadcast(m_wake);
+    SDL_mutexV(m_lock);
+
+    for(unsigned int i=0; i<m_workers.size(); ++i)
+        if(m_workers[i].thread)
+            SDL_WaitThread(m_workers[i].thread, NULL);
+
+    for(unsigned int i=0; i<m_queues.size(); ++i)
+        SDL_DestroyMutex(m_queues[i].lock);
+
+    SDL_DestroyCond(m_done);
+    SDL_DestroyCond(m_wake);
+    SDL_DestroyMutex(m_lock);
+}
+
+
+void JobPool::parallel_for(JobFunction function, void* data, int count, int grain)
+{
+    assert(grain > 0);
+
+    if(count <= 0)
+        return;
+
+    // not worth waking anybody up for
+    if(count <= grain || m_workers.empty()) {
+        function(data, 0, count);
+        return;
+    }
+
+    const int chunks = (count + grain - 1) / grain;
+
+    // count them before any go in the queues, a worker still looking
+    // for work from the last call could take one straight away
+    SDL_mutexP(m_lock);
+    assert(m_pending == 0);
+    m_queued += chunks;
+    m_pending += chunks;
+    SDL_mutexV(m_lock);
+
+    // deal the chunks out round robin
+    for(int i=0; i<chunks; ++i) {
+        Job job;
+        job.function = function;
+        job.data = data;
+        job.begin = i * grain;
+        job.end = job.begin + grain < count ? job.begin + grain : count;
+
+        Queue& queue = m_queues[i % m_queues.size()];
+        SDL_mutexP(queue.lock);
+        queue.jobs.push_back(job);
+        SDL_mutexV(queue.lock);
+    }
+
+    SDL_mutexP(m_lock);
+    SDL_CondBroadcast(m_wake);
+    SDL_mutexV(m_lock);
+
+    // help out until there's nothing left to take
+    Job job;
+    while(pop(0, job))
+        run(job);
+
+    // then wait for the chunks still running
+    SDL_mutexP(m_lock);
+    while(m_pending > 0)
+        SDL_CondWait(m_done, m_lock);
+    SDL_mutexV(m_lock);
+}
+
+
+bool JobPool::pop(int index, Job& job)
+{
+    bool found = false;
+
+    Queue& own = m_queues[index];
+    SDL_mutexP(own.lock);
+    if(!own.jobs.empty()) {
+        job = own.jobs.back();
+        own.jobs.pop_back();
+        found = true;
+    }
+    SDL_mutexV(own.lock);
+
+    // steal, starting with our neighbour so everyone doesn't hit the same queue
+    for(unsigned int i=1; !found && i<m_queues.size(); ++i) {
+        Queue& victim = m_queues[(index + i) % m_queues.size()];
+        SDL_mutexP(victim.lock);
+        if(!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            found = true;
+        }
+        SDL_mutexV(victim.lock);
+    }
+
+    if(found) {
+        SDL_mutexP(m_lock);
+        --m_queued;
+        SDL_mutexV(m_lock);
+    }
+    return found;
+}
+
+
+void JobPool::run(const Job& job)
+{
+    job.function(job.data, job.begin, job.end);
+
+    SDL_mutexP(m_lock);
+    if(--m_pending == 0)
+        SDL_CondBroadcast(m_done);
+    SDL_mutexV(m_lock);
+}
@@ -0,0 +1,44 @@
+/*
+====================
+File: Random.cc
+Author: Shane Lillie
+Description: Seedable random number generator source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#include "Random.h"
+
+
+/*
+ *  Random methods
+ *
+ */
+
+
+void Random::seed(Uint32 seed)
+{
+    // xorshift gets stuck on 0, and small seeds
+    // take a while to get going, so scramble it first
+    seed ^= 0x9e3779b9;
+    seed *= 0x85ebca6b;
+    seed ^= seed >> 13;
+
+    m_state = seed ? seed : 0x9e3779b9;
+}
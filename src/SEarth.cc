@@ -23,6 +23,9 @@ Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <cstdio>
 #include <iostream>
 
@@ -36,11 +39,16 @@ Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 #include "SDL_opengl.h"
 
 #include "SEarth.h"
-#include "DirtParticle.h"
 #include "LogicalFont.h"
+#include "TextAtlas.h"
+#include "SpriteBatch.h"
+#include "SpriteMask.h"
+#include "TextureCache.h"
+#include "Timeline.h"
 #include "main.h"
-#include "Callstack.h"
+#include "Trace.h"
 #include "Terrain.h"
+#include "JobPool.h"
 #include "utilities.h"
 
 
@@ -55,14 +63,42 @@ NOTE to self: SDL images are upside down, so GL tex coords are backwards in the
  */
 
 
-const int DEFAULT_WIDTH = 800;
-const int DEFAULT_HEIGHT = 600;
-
 #define TERRAINDIR "/terrain"
 
-#if defined WIN32
-    #define GL_BGR GL_BGR_EXT
-#endif
+// the simulation always steps at 240Hz, whatever the frame rate
+const float SIM_STEP = 1.0f / 240.0f;
+
+// don't try to catch up on more than this after a long frame
+const float MAX_FRAME_SEC = 0.25f;
+
+// give up on a headless shot after a minute of simulated time
+const int HEADLESS_MAX_STEPS = 240 * 60;
+
+// traced calls per thread dumped on a crash
+const int CRASH_TRACE_CALLS = 32;
+
+// cluster bombs fire this many at once, each up to
+// CLUSTER_SPREAD faster or slower (in each direction) than the aim
+const int CLUSTER_BOMBLETS = 24;
+const int CLUSTER_SPREAD = 60;
+
+// a MIRV splits into this many at the top of its arc
+const int MIRV_WARHEADS = 12;
+
+// the first tank drops in here, the rest spread out
+// to the same distance from the other side
+const float TANK_START_X = 70.0f;
+const float TANK_START_Y = 500.0f;
+
+// how far the arrow keys scroll the view
+const int VIEW_SCROLL = 64;
+
+const char* const WEAPON_NAMES[SEarth::WeaponCount] = {
+    "shell",
+    "cluster bomb",
+    "MIRV"
+};
+
 
 
 /*
@@ -71,18 +107,20 @@ const int DEFAULT_HEIGHT = 600;
  */
 
 
-Vector3<float> g_tank_pos(70.0f, 500.0f, 0.0f);
-Vector3<float> g_tank_vel;
+Vector3<float> g_collision_pos;
 
-Vector3<float> g_projectile_pos(100.0f, 217.0f, 0.0f);
-Vector3<float> g_projectile_vel(200.0f, 200.0f, 0.0f);
 
-Vector3<float> g_smoke_pos;
-const Vector3<float> g_smoke_vel(0.0f, 25.0f, 0.0f);
+/*
+ *  SEarth functions
+ *
+ */
 
-Vector3<float> g_collision_pos;
 
-DirtParticleSystem* g_dirt = NULL;
+const char* SEarth::weapon_name(Weapon weapon)
+{
+    assert(weapon >= 0 && weapon < WeaponCount);
+    return WEAPON_NAMES[weapon];
+}
 
 
 /*
@@ -93,9 +131,11 @@ DirtParticleSystem* g_dirt = NULL;
 
 SEarth::SEarth() throw(Engine::EngineException)
     : Engine(InitVideo | InitAudio | InitJoystick, data_directory() + NOIMAGE),
-        m_terrain(NULL)
+        m_terrain(NULL), m_background(-1), m_tank(-1), m_flare(-1), m_projectile(-1), m_smoke(-1),
+        m_turn(0), m_shots(0), m_impact_radius(0),
+        m_aim_pos(100.0f, 217.0f, 0.0f), m_aim_vel(200.0f, 200.0f, 0.0f), m_view_x(0), m_view_y(0), m_accumulator(0.0f), m_sprites(NULL), m_hud_font(NULL), m_hud_text(NULL), m_tank_mask(NULL), m_projectile_mask(NULL), m_jobs(NULL)
 {
-    ENTER_FUNCTION(SEarth::SEarth);
+    TRACE_FUNCTION(SEarth::SEarth);
 
     redirect_log("searth.log", false);
 
@@ -109,14 +149,43 @@ SEarth::SEarth() throw(Engine::EngineException)
 
 SEarth::~SEarth()
 {
+    m_entities.clear();
+
     if(m_terrain)
         delete m_terrain;
+
+    if(m_sprites)
+        delete m_sprites;
+
+    // the glyphs before the font they came from
+    if(m_hud_text)
+        delete m_hud_text;
+
+    if(m_hud_font)
+        delete m_hud_font;
+
+    if(m_tank_mask)
+        delete m_tank_mask;
+
+    if(m_projectile_mask)
+        delete m_projectile_mask;
+
+    if(m_jobs)
+        delete m_jobs;
+
+    m_timer.log();
+    Timeline::stop();
+
+    // whatever is left after the purge was never released
+    TextureCache::purge();
+    TextureCache::dump();
+    TextureCache::clear();
 }
 
 
 bool SEarth::create_window(const std::string& title)
 {
-    ENTER_FUNCTION(SEarth::create_window);
+    TRACE_FUNCTION(SEarth::create_window);
 
     if(m_state.fullscreen) {
         log("Trying fullscreen mode...\n");
@@ -157,16 +226,23 @@ bool SEarth::setup_extensions() const
 
 void SEarth::render_hud()
 {
-    ENTER_FUNCTION(SEarth::render_hud);
+    TRACE_FUNCTION(SEarth::render_hud);
 
     // load the font
-    static LogicalFont hud_font(font_directory() + "/cour.ttf", 14, TTF_STYLE_BOLD);
-    if(!hud_font.valid()) {
+    if(!m_hud_font)
+        m_hud_font = new LogicalFont(font_directory() + "/cour.ttf", 14, TTF_STYLE_BOLD);
+
+    if(!m_hud_font->valid()) {
         error("Could not load HUD font\n");
         do_quit();
         return;
     }
 
+    // the glyphs are rasterized once, then every
+    // string is just quads out of the one texture
+    if(!m_hud_text)
+        m_hud_text = new TextAtlas(*m_hud_font);
+
     // go 2d
     const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
     if(depth_test)
@@ -182,115 +258,45 @@ void SEarth::render_hud()
         glPushMatrix();
             glLoadIdentity();
 
-            int x=0, y=window_height() - hud_font.height(), w=0, h=0;
-            SDL_Surface* surface = NULL;
-            GLuint texture=0;
+            int y = window_height() - m_hud_text->height();
             char text[256];
 
-            SDL_Color color = { 0xff, 0xff, 0xff, 0x00 };
-
             if(m_state.fps) {
-                snprintf(text, 32, "FPS: %d", fps());
-                surface = hud_font.render_blended(text, color, w, h);
-
-                glGenTextures(1, &texture);
-                glBindTexture(GL_TEXTURE_2D, texture);
-
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surface->w, surface->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, surface->pixels);
+                std::snprintf(text, 256, "FPS: %d", fps());
+                m_hud_text->draw(text, 0, y);
 
-                y = window_height() - h;
-                float s = static_cast<float>(w) / surface->w;
-                float t = static_cast<float>(h) / surface->h;
-
-                glBegin(GL_QUADS);
-                    glNormal3f(0.0f, 0.0f, 1.0f);
-                    glTexCoord2f(0.0f, t); glVertex2f(x, y);
-                    glTexCoord2f(s, t); glVertex2f(x + w, y);
-                    glTexCoord2f(s, 0.0f); glVertex2f(x + w, y + h);
-                    glTexCoord2f(0.0f, 0.0f); glVertex2f(x, y + h);
-                glEnd();
-
-                glDeleteTextures(1, &texture);
-                SDL_FreeSurface(surface);
-
-                y -= hud_font.height();
+                y -= m_hud_text->height();
             }
 
-            static GLuint paused_texture = 0;
-            static int pw=0, ph=0;
-            static float ps=0, pt=0;
             if(m_state.paused) {
-                if(!paused_texture) {
-                    std::strncpy(text, "Paused", 32);
-                    surface = hud_font.render_blended(text, color, w, h);
-
-                    glGenTextures(1, &paused_texture);
-                    glBindTexture(GL_TEXTURE_2D, paused_texture);
-
-                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-                    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surface->w, surface->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, surface->pixels);
-
-                    pw = w;
-                    ph = h;
-
-                    ps = static_cast<float>(pw) / surface->w;
-                    pt = static_cast<float>(ph) / surface->h;
+                m_hud_text->draw("Paused", 0, y);
 
-                    SDL_FreeSurface(surface);
-                }
-                glBindTexture(GL_TEXTURE_2D, paused_texture);
-
-                glBegin(GL_QUADS);
-                    glNormal3f(0.0f, 0.0f, 1.0f);
-                    glTexCoord2f(0.0f, pt); glVertex2f(x, y);
-                    glTexCoord2f(ps, pt); glVertex2f(x + pw, y);
-                    glTexCoord2f(ps, 0.0f); glVertex2f(x + pw, y + ph);
-                    glTexCoord2f(0.0f, 0.0f); glVertex2f(x, y + ph);
-                glEnd();
-
-                y -= hud_font.height();
+                y -= m_hud_text->height();
             }
 
-            static GLuint demo_texture = 0;
-            static int dw=0, dh=0;
-            static float ds=0.0f, dt=0.0f;
-            if(!demo_texture) {
-                std::strncpy(text, "SEarth Tech Demo (c) 2003 Energon Software", 256);
-                surface = hud_font.render_blended(text, color, w, h);
-
-                glGenTextures(1, &demo_texture);
-                glBindTexture(GL_TEXTURE_2D, demo_texture);
+            std::snprintf(text, 256, "Weapon: %s", weapon_name(m_state.weapon));
+            m_hud_text->draw(text, 0, y);
 
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            y -= m_hud_text->height();
 
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surface->w, surface->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, surface->pixels);
+            // the last finished frame, so this one's
+            // own HUD and flip are left out
+            if(m_state.timings && m_timer.frames() > 0) {
+                for(int i=0; i<FrameTimer::PhaseCount; ++i) {
+                    const FrameTimer::Phase phase = static_cast<FrameTimer::Phase>(i);
+                    std::snprintf(text, 256, "%-16s %6.2f ms (p95 %6.2f)", FrameTimer::name(phase),
+                        m_timer.last(phase) / 1000.0f, m_timer.percentile(phase, 95) / 1000.0f);
+                    m_hud_text->draw(text, 0, y);
 
-                dw = w;
-                dh = h;
-
-                ds = static_cast<float>(dw) / surface->w;
-                dt = static_cast<float>(dh) / surface->h;
-
-                SDL_FreeSurface(surface);
+                    y -= m_hud_text->height();
+                }
             }
-            glBindTexture(GL_TEXTURE_2D, demo_texture);
 
-            x = (window_width() / 2) - (dw / 2);
-            y = 5;
+            static const char demo[] = "SEarth Tech Demo (c) 2003 Energon Software";
+            m_hud_text->draw(demo, (window_width() / 2) - (m_hud_text->width(demo) / 2), 5);
 
-            glBegin(GL_QUADS);
-                glNormal3f(0.0f, 0.0f, 1.0f);
-                glTexCoord2f(0.0f, dt); glVertex2f(x, y);
-                glTexCoord2f(ds, dt); glVertex2f(x + dw, y);
-                glTexCoord2f(ds, 0.0f); glVertex2f(x + dw, y + dh);
-                glTexCoord2f(0.0f, 0.0f); glVertex2f(x, y + dh);
-            glEnd();
+            glColor3f(1.0f, 1.0f, 1.0f);
+            m_hud_text->flush();
 
         glPopMatrix();
     glMatrixMode(GL_PROJECTION);
@@ -298,14 +304,12 @@ void SEarth::render_hud()
 
     if(depth_test)
         glEnable(GL_DEPTH_TEST);
-
-/* DELETE TEXTURES */
 }
 
 
 void SEarth::screenshot() const
 {
-    ENTER_FUNCTION(SEarth::screenshot);
+    TRACE_FUNCTION(SEarth::screenshot);
 
 /* FIXME: this is an accident waiting to happen */
     static const char name[] = PROGRAM_NAME;
@@ -327,457 +331,410 @@ void SEarth::screenshot() const
 }
 
 
-void render_background(int surface, GLfloat window_width, GLfloat window_height)
+bool SEarth::main()
 {
-    if(surface < 0)
-        return;
-
-    static GLuint texture = 0;
-    if(!texture) {
-        glGenTextures(1, &texture);
-
-        glBindTexture(GL_TEXTURE_2D, texture);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-        if(SEarth::surface_Bpp(surface) != 3) {
-            SEarth::error("Background must be 24 bits\n");
-            return;
-        }
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SEarth::surface_width(surface), SEarth::surface_height(surface),
-            0, GL_BGR, GL_UNSIGNED_BYTE, SEarth::surface_pixels(surface));
-    }
+    TRACE_FUNCTION(SEarth::main);
 
-    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
-    if(depth_test)
-        glDisable(GL_DEPTH_TEST);
+    log("Using seed %u\n", m_state.seed);
+    m_random.seed(m_state.seed);
 
-    const GLboolean blend = glIsEnabled(GL_BLEND);
-    if(blend)
-        glDisable(GL_BLEND);
+    const int threads = m_state.threads > 0 ? m_state.threads : JobPool::cpu_count();
+    log("Using %d simulation threads\n", threads);
+    m_jobs = new JobPool(threads);
 
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-        glLoadIdentity();
+    if(!m_state.trace_file.empty())
+        Timeline::start(m_state.trace_file);
 
-        gluOrtho2D(0.0f, window_width, 0.0f, window_height);
+    if(m_state.headless_shots > 0)
+        return run_headless();
 
-        glMatrixMode(GL_MODELVIEW);
-        glPushMatrix();
-            glLoadIdentity();
-
-            glBindTexture(GL_TEXTURE_2D, texture);
-
-            const GLfloat s = static_cast<GLfloat>(window_width) / static_cast<GLfloat>(SEarth::surface_width(surface));
-            const GLfloat t = static_cast<GLfloat>(window_height) / static_cast<GLfloat>(SEarth::surface_height(surface));
-
-            //glColor3f(1.0f, 1.0f, 1.0f);
-            glBegin(GL_QUADS);
-                glNormal3f(0.0f, 0.0f, 1.0f);
-                glTexCoord2f(0.0f, t); glVertex2f(0.0f, 0.0f);
-                glTexCoord2f(s, t); glVertex2f(window_width - 1.0f, 0.0f);
-                glTexCoord2f(s, 0.0f); glVertex2f(window_width - 1.0f, window_height - 1.0f);
-                glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, window_height - 1.0f);
-            glEnd();
-        glPopMatrix();
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
+    if(!create_window(WINDOW_TITLE))
+        return false;
 
-    if(blend)
-        glEnable(GL_BLEND);
+    print();
 
-    if(depth_test)
-        glEnable(GL_DEPTH_TEST);
+    while(!should_quit())
+        event_loop();
+    return true;
 }
 
 
-void render_tank(int surface, GLfloat window_width, GLfloat window_height)
+bool SEarth::run_headless()
 {
-    if(surface < 0)
-        return;
-
-    static GLuint texture = 0;
-    if(!texture) {
-        glGenTextures(1, &texture);
-
-        glBindTexture(GL_TEXTURE_2D, texture);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    TRACE_FUNCTION(SEarth::run_headless);
 
-        if(SEarth::surface_Bpp(surface) != 4) {
-            SEarth::error("Tank must be 32 bits\n");
-            return;
-        }
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SEarth::surface_width(surface), SEarth::surface_height(surface),
-            0, GL_BGRA, GL_UNSIGNED_BYTE, SEarth::surface_pixels(surface));
-    }
-
-    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
-    if(depth_test)
-        glDisable(GL_DEPTH_TEST);
+    log("Running %d shots headless with seed %u...\n", m_state.headless_shots, m_state.seed);
 
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-        glLoadIdentity();
+    // there's no window, so a .set map is the default window size
+    if(!load_world(DEFAULT_WIDTH, DEFAULT_HEIGHT))
+        return false;
 
-        gluOrtho2D(0.0f, window_width, 0.0f, window_height);
+    const Uint32 start = SDL_GetTicks();
 
-        glMatrixMode(GL_MODELVIEW);
-        glPushMatrix();
-            glLoadIdentity();
+    int steps = 0, shot_steps = 0;
+    while(m_shots < m_state.headless_shots || m_entities.bursts() > 0 || !m_terrain->settled()) {
+        const int shots = m_shots;
 
-            glTranslatef(g_tank_pos.x(), g_tank_pos.y(), g_tank_pos.z());
-            // rotate to match ground...
+        m_timer.begin_frame();
+        simulate(SIM_STEP);
+        end_frame();
+        ++steps;
 
-            glBindTexture(GL_TEXTURE_2D, texture);
+        if(m_shots != shots) {
+            std::cout << "shot " << m_shots << ": " << g_collision_pos.x() << " " << g_collision_pos.y()
+                << " radius " << m_impact_radius << " steps " << shot_steps << std::endl;
+            shot_steps = 0;
+        } else if(++shot_steps > HEADLESS_MAX_STEPS) {
+            error("Shot %d never landed, giving up\n", m_shots + 1);
+            return false;
+        }
+    }
 
-            //glColor3f(1.0f, 1.0f, 1.0f);
-            glBegin(GL_QUADS);
-                glNormal3f(0.0f, 0.0f, 1.0f);
-                glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, 0.0f);
-                glTexCoord2f(1.0f, 1.0f); glVertex2f(SEarth::surface_width(surface) - 1.0f, 0.0f);
-                glTexCoord2f(1.0f, 0.0f); glVertex2f(SEarth::surface_width(surface) - 1.0f, SEarth::surface_height(surface) - 1.0f);
-                glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, SEarth::surface_height(surface) - 1.0f);
-            glEnd();
-        glPopMatrix();
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
+    const Uint32 ticks = SDL_GetTicks() - start;
+    std::cout << "simulated " << m_shots << " shots, " << steps << " steps ("
+        << (steps * SIM_STEP) << "s) in " << ticks << "ms, seed " << m_state.seed << std::endl;
 
-    if(depth_test)
-        glEnable(GL_DEPTH_TEST);
+    log("Headless run finished: %d steps in %ums\n", steps, ticks);
+    return true;
 }
 
 
-void render_projectile(int flare, int projectile, GLfloat window_width, GLfloat window_height)
+bool SEarth::load_world(int width, int height)
 {
-    if(flare < 0 || projectile < 0)
-        return;
-
-    static GLuint flare_texture = 0;
-    if(!flare_texture) {
-        glGenTextures(1, &flare_texture);
-
-        glBindTexture(GL_TEXTURE_2D, flare_texture);
+    TRACE_FUNCTION(SEarth::load_world);
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-        if(SEarth::surface_Bpp(flare) != 4) {
-            SEarth::error("Flare must be 32 bits\n");
-            return;
+    if(!m_terrain) {
+        try {
+            // prefer the binary terrain, it doesn't have to be parsed
+            try {
+                m_terrain = new Terrain(data_directory() + TERRAINDIR + "/test.stb", width, height);
+            } catch(Terrain::TerrainException& e) {
+                log("%s, falling back to test.set\n", e.what());
+                m_terrain = new Terrain(data_directory() + TERRAINDIR + "/test.set", width, height);
+            }
+        } catch(Terrain::TerrainException& e) {
+            error(e.what());
+            return false;
         }
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SEarth::surface_width(flare), SEarth::surface_height(flare),
-            0, GL_BGRA, GL_UNSIGNED_BYTE, SEarth::surface_pixels(flare));
-    }
-
-    static GLuint projectile_texture = 0;
-    if(!projectile_texture) {
-        glGenTextures(1, &projectile_texture);
 
-        glBindTexture(GL_TEXTURE_2D, projectile_texture);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-        if(SEarth::surface_Bpp(projectile) != 4) {
-            SEarth::error("Projectile must be 32 bits\n");
-            return;
-        }
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SEarth::surface_width(projectile), SEarth::surface_height(projectile),
-            0, GL_BGRA, GL_UNSIGNED_BYTE, SEarth::surface_pixels(projectile));
+        log("Loaded a %dx%d map\n", m_terrain->width(), m_terrain->height());
     }
 
-    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
-    if(depth_test)
-        glDisable(GL_DEPTH_TEST);
+    // the sprites double as collision masks,
+    // so these get loaded headless too
+    if(m_tank < 0) {
+        m_tank = load_image(data_directory() +  "/images/tank.tga");
 
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-        glLoadIdentity();
+        // color based on player value
+        // alpha value becomes color intensity
+        // remember, tgas are BGR (fuck, not really now?)
+        lock_surface(m_tank);
 
-        gluOrtho2D(0.0f, window_width, 0.0f, window_height);
+            for(int x=0; x<surface_width(m_tank); ++x) {
+                for(int y=0; y<surface_height(m_tank); ++y) {
+                    Uint8 r, g, b, a;
+                    get_rgba(m_tank, pixel(m_tank, x, y), &r, &g, &b, &a);
 
-        glMatrixMode(GL_MODELVIEW);
-        glPushMatrix();
-            glLoadIdentity();
+                    pixel(m_tank, x, y, map_rgba(m_tank, 0, 0, a, a ? 255 : 0));
+                }
+            }
 
-            const float hw = SEarth::surface_width(projectile) / 2.0f;
-            const float hh = SEarth::surface_height(projectile) / 2.0f;
+        unlock_surface(m_tank);
+    }
 
-            glTranslatef(g_projectile_pos.x() + hw, g_projectile_pos.y() + hh, g_tank_pos.z());
+    if(m_projectile < 0)
+        m_projectile = load_image(data_directory() +  "/images/projectile.tga");
 
-            Vector2<float> vec(g_projectile_vel.x(), g_projectile_vel.y());
-            glRotatef(RAD_DEG(vec.angle()), 0.0f, 0.0f, 1.0f);
+    if(m_tank < 0 || m_projectile < 0)
+        return false;
 
-            glBindTexture(GL_TEXTURE_2D, flare_texture);
+    // collision tests go through these, never the surfaces
+    if(!m_tank_mask)
+        m_tank_mask = new SpriteMask(m_tank);
 
-            glColor3f(0.6f, 0.3f, 0.0f);
-            glBegin(GL_QUADS);
-                glNormal3f(0.0f, 0.0f, 1.0f);
-                glTexCoord2f(0.0f, 1.0f); glVertex2f(-SEarth::surface_width(projectile) - hw, -SEarth::surface_height(projectile));
-                glTexCoord2f(1.0f, 1.0f); glVertex2f(-SEarth::surface_width(projectile) - hw + SEarth::surface_width(flare) - 1.0f, -SEarth::surface_height(projectile));
-                glTexCoord2f(1.0f, 0.0f); glVertex2f(-SEarth::surface_width(projectile) - hw + SEarth::surface_width(flare) - 1.0f, -SEarth::surface_height(projectile) + SEarth::surface_height(flare) - 1.0f);
-                glTexCoord2f(0.0f, 0.0f); glVertex2f(-SEarth::surface_width(projectile) - hw, -SEarth::surface_height(projectile) + SEarth::surface_height(flare) - 1.0f);
-            glEnd();
+    if(!m_projectile_mask)
+        m_projectile_mask = new SpriteMask(m_projectile);
 
-            glBindTexture(GL_TEXTURE_2D, projectile_texture);
+    if(!m_tanks.count()) {
+        const int tanks = std::max(m_state.tanks, 1);
+        const float spacing = tanks > 1 ? (m_terrain->width() - surface_width(m_tank) - (2.0f * TANK_START_X)) / (tanks - 1) : 0.0f;
 
-            glColor3f(1.0f, 1.0f, 1.0f);
-            glBegin(GL_QUADS);
-                glNormal3f(0.0f, 0.0f, 1.0f);
-                glTexCoord2f(0.0f, 1.0f); glVertex2f(-hw, -hh);
-                glTexCoord2f(1.0f, 1.0f); glVertex2f(-hw + SEarth::surface_width(projectile) - 1.0f, -hh);
-                glTexCoord2f(1.0f, 0.0f); glVertex2f(-hw + SEarth::surface_width(projectile) - 1.0f, -hh + SEarth::surface_height(projectile) - 1.0f);
-                glTexCoord2f(0.0f, 0.0f); glVertex2f(-hw, -hh + SEarth::surface_height(projectile) - 1.0f);
-            glEnd();
-        glPopMatrix();
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
+        // short maps drop them from the top
+        const float start_y = std::min(TANK_START_Y, static_cast<float>(m_terrain->height() - surface_height(m_tank)));
+        for(int i=0; i<tanks; ++i)
+            m_tanks.add(Vector3<float>(TANK_START_X + (i * spacing), start_y, 0.0f));
+    }
 
-    if(depth_test)
-        glEnable(GL_DEPTH_TEST);
+    return true;
 }
 
 
-void render_smoke(int surface, GLfloat window_width, GLfloat window_height)
+void SEarth::simulate(float elapsed_sec)
 {
-    if(surface < 0)
-        return;
+    TRACE_FUNCTION(SEarth::simulate);
 
-    static GLuint texture = 0;
-    if(!texture) {
-        glGenTextures(1, &texture);
-
-        glBindTexture(GL_TEXTURE_2D, texture);
+/* TODO: write down these fucking physics formulas! */
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // drop the tanks (only the ones the terrain moved under)
+    {
+        FrameTimer::Scope timing(m_timer, FrameTimer::TankPhysics);
+        m_tanks.update(*m_terrain, *m_tank_mask, elapsed_sec);
+    }
 
-        if(SEarth::surface_Bpp(surface) != 4) {
-            SEarth::error("Smoke must be 32 bits\n");
-            return;
-        }
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SEarth::surface_width(surface), SEarth::surface_height(surface),
-            0, GL_BGRA, GL_UNSIGNED_BYTE, SEarth::surface_pixels(surface));
+    // update the dirt and smoke
+    if(m_entities.bursts() > 0) {
+        FrameTimer::Scope timing(m_timer, FrameTimer::ParticleUpdate);
+        m_entities.update_bursts(m_terrain, elapsed_sec, m_jobs);
     }
 
-    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
-    if(depth_test)
-        glDisable(GL_DEPTH_TEST);
+    // let the dirt fall until every column has settled
+    if(!m_terrain->settled()) {
+        FrameTimer::Scope timing(m_timer, FrameTimer::Slide);
+        m_terrain->slide(elapsed_sec, m_jobs);
+    }
 
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-        glLoadIdentity();
+    // the next shot goes once the last one is done with
+    // (and headless, only until we've had all we asked for)
+    const bool shots_left = m_state.headless_shots <= 0 || m_shots < m_state.headless_shots;
+    if(shots_left && m_tanks.resting(m_turn) && m_entities.empty())
+        fire();
+
+    // move projectiles
+    if(m_entities.projectiles() > 0) {
+        FrameTimer::Scope timing(m_timer, FrameTimer::Projectile);
+
+        m_impacts.clear();
+        m_entities.update_projectiles(*m_terrain, *m_projectile_mask, elapsed_sec, m_random, m_impacts);
+
+        // every crater goes in before the dirt flies, so they
+        // all settle in the same slides and go up in one upload
+        for(std::vector<Entities::Impact>::const_iterator impact = m_impacts.begin(); impact != m_impacts.end(); ++impact) {
+            // deform the terrain by 1/5 the velocity
+            m_impact_radius = static_cast<int>(impact->vel.length() / 5);
+            m_terrain->deform(impact->pos, m_impact_radius);
+        }
 
-        gluOrtho2D(0.0f, window_width, 0.0f, window_height);
+        for(std::vector<Entities::Impact>::const_iterator impact = m_impacts.begin(); impact != m_impacts.end(); ++impact) {
+            // make off the ground 1px
+            // (a zero velocity component would make this NaN
+            // and the dirt would never land)
+            const float x = -impact->vel.x();
+            const float y = -impact->vel.y();
+            const Vector3<float> pos(impact->pos + Vector3<float>(x ? x / std::fabs(x) : 0.0f, y ? y / std::fabs(y) : 0.0f, 0.0f));
 
-        glMatrixMode(GL_MODELVIEW);
-        glPushMatrix();
-            glLoadIdentity();
+            // shower us with particles
+            m_entities.add_burst(*impact, pos, m_random);
 
-            glTranslatef(g_smoke_pos.x() - (SEarth::surface_width(surface) / 2), g_smoke_pos.y() - (SEarth::surface_height(surface) / 2), g_smoke_pos.z());
-
-            glBindTexture(GL_TEXTURE_2D, texture);
+            g_collision_pos = impact->pos;
+        }
 
-            //glColor3f(1.0f, 1.0f, 1.0f);
-            glBegin(GL_QUADS);
-                glNormal3f(0.0f, 0.0f, 1.0f);
-                glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, 0.0f);
-                glTexCoord2f(1.0f, 1.0f); glVertex2f(SEarth::surface_width(surface) - 1.0f, 0.0f);
-                glTexCoord2f(1.0f, 0.0f); glVertex2f(SEarth::surface_width(surface) - 1.0f, SEarth::surface_height(surface) - 1.0f);
-                glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, SEarth::surface_height(surface) - 1.0f);
-            glEnd();
-        glPopMatrix();
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
+        // aim the next tank's shot once the whole salvo is down
+        if(!m_impacts.empty() && !m_entities.projectiles()) {
+            m_turn = (m_turn + 1) % m_tanks.count();
+            m_aim_pos = m_tanks.position(m_turn) + Vector3<float>(surface_width(m_tank), surface_height(m_tank), 0.0f);
+#if 1
+            m_aim_vel = Vector3<float>(m_random.range(300), m_random.range(300), 0.0f);
+#else
+            m_aim_vel = Vector3<float>(3, m_random.range(300), 0.0f);
+#endif
 
-    if(depth_test)
-        glEnable(GL_DEPTH_TEST);
+            ++m_shots;
+        }
+    }
 }
 
 
-
-bool SEarth::main()
+void SEarth::fire()
 {
-    ENTER_FUNCTION(SEarth::main);
-
-    if(!create_window(WINDOW_TITLE))
-        return false;
-
-    print();
-
-    while(!should_quit())
-        event_loop();
-    return true;
+    switch(m_state.weapon)
+    {
+    case ClusterBomb:
+        for(int i=0; i<CLUSTER_BOMBLETS; ++i) {
+            const Vector3<float> spread(m_random.range(-CLUSTER_SPREAD, CLUSTER_SPREAD), m_random.range(-CLUSTER_SPREAD, CLUSTER_SPREAD), 0.0f);
+            m_entities.add_projectile(m_aim_pos, m_aim_vel + spread);
+        }
+        break;
+    case Mirv:
+        m_entities.add_projectile(m_aim_pos, m_aim_vel, MIRV_WARHEADS);
+        break;
+    default:
+        m_entities.add_projectile(m_aim_pos, m_aim_vel);
+        break;
+    }
 }
 
 
-void SEarth::event_handler()
+void SEarth::render(float alpha)
 {
-    if(!m_terrain) {
-        try {
-            m_terrain = new Terrain(data_directory() + TERRAINDIR + "/test.set", window_width(), window_height());
-        } catch(Terrain::TerrainException& e) {
-            error(e.what());
-            do_quit();
-            return;
-        }
-    }
-
-    static int background = -1;
-    if(background < 0)
-        background = load_image(data_directory() +  "/images/space.tga");
+    TRACE_FUNCTION(SEarth::render);
 
-    static int tank = -1;
-    if(tank < 0) {
-        tank = load_image(data_directory() +  "/images/tank.tga");
+    if(m_background < 0)
+        m_background = load_image(data_directory() +  "/images/space.tga");
 
-        // color based on player value
-        // alpha value becomes color intensity
-        // remember, tgas are BGR (fuck, not really now?)
-        lock_surface(tank);
+    if(m_flare < 0)
+        m_flare = load_image(data_directory() +  "/images/flare.tga");
 
-            for(int x=0; x<surface_width(tank); ++x) {
-                for(int y=0; y<surface_height(tank); ++y) {
-                    Uint8 r, g, b, a;
-                    get_rgba(tank, pixel(tank, x, y), &r, &g, &b, &a);
+    if(m_smoke < 0)
+        m_smoke = load_image(data_directory() +  "/images/smoke.tga");
 
-                    pixel(tank, x, y, map_rgba(tank, 0, 0, a, a ? 255 : 0));
-                }
-            }
+    if(!m_sprites) {
+        m_sprites = new SpriteBatch();
 
-        unlock_surface(tank);
+        // the background tiles, everything else shares the atlas
+        m_sprites->add(m_background, true);
+        m_sprites->add(m_tank);
+        m_sprites->add(m_flare);
+        m_sprites->add(m_projectile);
+        m_sprites->add(m_smoke);
     }
 
-    static int flare = -1;
-    if(flare < 0)
-        flare = load_image(data_directory() +  "/images/flare.tga");
-
-    static int projectile = -1;
-    if(projectile < 0)
-        projectile = load_image(data_directory() +  "/images/projectile.tga");
-
-    static int smoke = -1;
-    if(smoke < 0)
-        smoke = load_image(data_directory() +  "/images/smoke.tga");
-
     clear_window();
 
-    render_background(background, window_width(), window_height());
+    // the background goes under the terrain, so it gets a flush of its own
+    {
+        FrameTimer::Scope timing(m_timer, FrameTimer::Background);
+
+        if(m_background >= 0) {
+            SpriteBatch::Sprite background(m_background, 0.0f, 0.0f, window_width(), window_height());
+            background.blend = SpriteBatch::BlendNone;
+            background.s = static_cast<float>(window_width()) / static_cast<float>(surface_width(m_background));
+            background.t = static_cast<float>(window_height()) / static_cast<float>(surface_height(m_background));
+            m_sprites->draw(background);
+        }
+        m_sprites->flush(0, 0, window_width(), window_height());
+    }
 
-    m_terrain->render();
+    {
+        FrameTimer::Scope timing(m_timer, FrameTimer::TerrainRender);
+        update_view();
+        m_terrain->render();
+    }
 
-/* TODO: write down these fucking physics formulas! */
+    // draw everything between the last two steps
+    {
+        FrameTimer::Scope timing(m_timer, FrameTimer::Sprites);
 
-    // move tank (-190.0f is gravity)
-    bool tank_collision = false;
-    if(!m_state.paused) {
-        Vector3<float> vavg(g_tank_vel.x(), g_tank_vel.y() + ((-190.0f / 2.0f) * elapsed_sec()), g_tank_vel.z());
-        Vector3<float> pos(g_tank_pos + (vavg * elapsed_sec()));
+        for(int i=0; i<m_tanks.count(); ++i) {
+            const Vector3<float> tank(m_tanks.position(i, alpha));
+            m_sprites->draw(m_tank, tank.x(), tank.y());
+        }
 
-        g_tank_vel.y(g_tank_vel.y() + (-190.0f * elapsed_sec()));
+        if(m_smoke >= 0) {
+            for(int i=0; i<m_entities.bursts(); ++i) {
+                const Vector3<float> smoke(m_entities.smoke(i, alpha));
+                m_sprites->draw(m_smoke, smoke.x() - (surface_width(m_smoke) / 2), smoke.y() - (surface_height(m_smoke) / 2));
+            }
+        }
 
-        if(m_terrain->collision(g_tank_pos, pos, vavg, &g_collision_pos, tank)) {
-            g_tank_pos = g_collision_pos;
-            g_tank_vel.clear();
+        for(int i=0; i<m_entities.projectiles(); ++i)
+            draw_projectile(m_entities.projectile(i, alpha), m_entities.projectile_velocity(i));
 
-            // we hit the ground, but is it enough?
-            const int slide = m_terrain->would_fall(static_cast<int>(g_tank_pos.x()), static_cast<int>(g_tank_pos.y()), tank);
-            g_tank_pos.x(g_tank_pos.x() + slide);
+        m_sprites->flush(m_view_x, m_view_y, window_width(), window_height());
+    }
 
-            tank_collision = slide == 0;
-        } else
-            g_tank_pos = pos;
-    } else
-        tank_collision = true;
+    if(m_entities.bursts() > 0) {
+        FrameTimer::Scope timing(m_timer, FrameTimer::ParticleRender);
+        m_entities.render(alpha, m_view_x, m_view_y, window_width(), window_height());
+    }
 
-    // render tank
-    render_tank(tank, window_width(), window_height());
+    {
+        FrameTimer::Scope timing(m_timer, FrameTimer::Hud);
+        render_hud();
+    }
 
-    // render dirt
-    static bool should_slide = false;
-    if(g_dirt) {
-        if(!m_state.paused)
-            g_dirt->update(m_terrain, elapsed_sec());
+    FrameTimer::Scope timing(m_timer, FrameTimer::Flip);
+    flip();
+}
 
-        g_dirt->render(window_width(), window_height());
 
-        render_smoke(smoke, window_width(), window_height());
+void SEarth::update_view()
+{
+    // maps smaller than the window stay in the bottom left
+    m_view_x = std::max(std::min(m_view_x, m_terrain->width() - window_width()), 0);
+    m_view_y = std::max(std::min(m_view_y, m_terrain->height() - window_height()), 0);
 
-        if(!m_state.paused) {
-            Vector3<float> vavg(g_smoke_vel.x(), g_smoke_vel.y(), g_smoke_vel.z());
-            Vector3<float> pos(g_smoke_pos + (vavg * elapsed_sec()));
+    m_terrain->set_view(m_view_x, m_view_y, window_width(), window_height());
+}
 
-            g_smoke_pos = pos;
-        }
 
-        if(!m_state.paused) {
-            if(g_dirt->finished() && !should_slide) {
-                delete g_dirt;
-                g_dirt = NULL;
-            }
+void SEarth::draw_projectile(const Vector3<float>& pos, const Vector3<float>& vel)
+{
+    if(m_flare < 0 || m_projectile < 0)
+        return;
 
-            if(should_slide)
-                should_slide = m_terrain->slide(elapsed_sec());
-        }
-    }
+    const float pw = surface_width(m_projectile), ph = surface_height(m_projectile);
+    const float hw = pw / 2.0f, hh = ph / 2.0f;
+
+    // both turn with the projectile around its center
+    const float angle = RAD_DEG(Vector2<float>(vel.x(), vel.y()).angle());
+
+    // the flare trails behind it
+    SpriteBatch::Sprite flare(m_flare, pos.x() + hw, pos.y() + hh, surface_width(m_flare), surface_height(m_flare));
+    flare.left -= pw + hw; flare.right -= pw + hw;
+    flare.bottom -= ph; flare.top -= ph;
+    flare.angle = angle;
+    flare.r = 0.6f; flare.g = 0.3f; flare.b = 0.0f;
+    m_sprites->draw(flare);
+
+    SpriteBatch::Sprite projectile(m_projectile, pos.x() + hw, pos.y() + hh, surface_width(m_projectile), surface_height(m_projectile));
+    projectile.left -= hw; projectile.right -= hw;
+    projectile.bottom -= hh; projectile.top -= hh;
+    projectile.angle = angle;
+    m_sprites->draw(projectile);
+}
 
-    // move projectile
-    if(tank_collision && !g_dirt) {
-        if(!m_state.paused) {
-            // move projectile (-190.0f is gravity)
-            Vector3<float> vavg(g_projectile_vel.x(), g_projectile_vel.y() + ((-190.0f / 2.0f) * elapsed_sec()), g_projectile_vel.z());
-            Vector3<float> pos(g_projectile_pos + (vavg * elapsed_sec()));
 
-            g_projectile_vel.y(g_projectile_vel.y() + (-190.0f * elapsed_sec()));
+void SEarth::event_handler()
+{
+    TRACE_FUNCTION(SEarth::event_handler);
 
-            if(m_terrain->collision(g_projectile_pos, pos, vavg, &g_collision_pos, projectile)) {
-                // deform the terrain by 1/5 the velocity
-                m_terrain->deform(g_collision_pos, static_cast<int>(g_projectile_vel.length() / 5));
+    if(!load_world(window_width(), window_height())) {
+        do_quit();
+        return;
+    }
 
-                // make off the ground 1px
-                const float x = -g_projectile_vel.x();
-                const float y = -g_projectile_vel.y();
-                pos = g_collision_pos + Vector3<float>(x / std::fabs(x), y / std::fabs(y), 0.0f);
+    m_timer.begin_frame();
 
-                // create the dirt and shower us with particles (at half the impact velocity)
-                g_dirt = new DirtParticleSystem(pos, g_projectile_vel.length() / -2.0f, g_projectile_vel.vec2().angle());
-                g_dirt->emit_max();
-                g_dirt->render(window_width(), window_height());
+    // run however many fixed steps fit in the frame,
+    // the leftover carries over to the next one
+    if(!m_state.paused) {
+        m_accumulator += std::min(elapsed_sec(), MAX_FRAME_SEC);
+        while(m_accumulator >= SIM_STEP) {
+            simulate(SIM_STEP);
+            m_accumulator -= SIM_STEP;
+        }
+    }
 
-                g_smoke_pos = g_collision_pos;
-                render_smoke(smoke, window_width(), window_height());
+    render(m_accumulator / SIM_STEP);
 
-                // reset the projectile info
-                g_projectile_pos = g_tank_pos + Vector3<float>(surface_width(tank), surface_height(tank), 0.0f);
-#if 1
-                g_projectile_vel = Vector3<float>(rand() % 300, rand() % 300, 0.0f);
-#else
-                g_projectile_vel = Vector3<float>(3, rand() % 300, 0.0f);
-#endif
+    end_frame();
+}
 
-                should_slide = true;
-            } else
-                g_projectile_pos = pos;
-        }
 
-        if(!g_dirt)
-            render_projectile(flare, projectile, window_width(), window_height());
+void SEarth::end_frame()
+{
+    m_timer.end_frame();
+
+    if(Timeline::recording()) {
+        Timeline::counter("awake tanks", m_tanks.awake());
+        Timeline::counter("projectiles", m_entities.projectiles());
+        Timeline::counter("live particles", m_entities.particles());
+        Timeline::counter("unsettled columns", m_terrain ? m_terrain->unsettled_columns() : 0);
+
+        // per frame, not the running total
+        static unsigned int uploaded = 0;
+        const unsigned int total = TextureCache::stats().uploaded + (m_terrain ? m_terrain->uploaded_bytes() : 0);
+        Timeline::counter("texture bytes uploaded", total - uploaded);
+        uploaded = total;
     }
 
-    render_hud();
-
-    flip();
+    Timeline::end_frame();
 }
 
 
 bool SEarth::initialize_opengl() const
 {
-    ENTER_FUNCTION(SEarth::initialize_opengl);
+    TRACE_FUNCTION(SEarth::initialize_opengl);
 
     if(!setup_extensions())
         return false;
@@ -847,6 +804,29 @@ break;
             dump_surfaces();
         //}
         break;
+    case SDLK_t:
+        TextureCache::dump();
+        break;
+    case SDLK_h:
+        m_state.timings = !m_state.timings;
+        break;
+    case SDLK_w:
+        // takes effect on the next shot
+        m_state.weapon = static_cast<Weapon>((m_state.weapon + 1) % WeaponCount);
+        log("Switched to %s\n", weapon_name(m_state.weapon));
+        break;
+    case SDLK_LEFT:
+        m_view_x -= VIEW_SCROLL;
+        break;
+    case SDLK_RIGHT:
+        m_view_x += VIEW_SCROLL;
+        break;
+    case SDLK_DOWN:
+        m_view_y -= VIEW_SCROLL;
+        break;
+    case SDLK_UP:
+        m_view_y += VIEW_SCROLL;
+        break;
     case SDLK_F11:
         screenshot();
     default:
@@ -872,7 +852,7 @@ void SEarth::on_key_up(SDLKey key)
 void SEarth::on_sigsegv()
 {
     error("Segmentation Fault caught, exiting cleanly...\n");
-    Callstack::dump(std::cerr);
+    Trace::dump(std::cerr, CRASH_TRACE_CALLS);
     exit(1);
 }
 
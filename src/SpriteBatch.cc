@@ -0,0 +1,371 @@
+/*
+====================
+File: SpriteBatch.cc
+Author: Shane Lillie
+Description: Sprite batching source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "SDL_opengl.h"
+
+#include "SpriteBatch.h"
+#include "TextureCache.h"
+#include "SEarth.h"
+#include "Vector.h"
+
+
+/*
+ *  functions
+ *
+ */
+
+
+// atlas packing order, tallest first
+bool taller(const std::pair<int, int>& lhs, const std::pair<int, int>& rhs)
+{
+    return lhs.first > rhs.first;
+}
+
+
+/*
+ *  SpriteBatch class constants
+ *
+ */
+
+
+const int SpriteBatch::ATLAS_WIDTH = 256;
+const int SpriteBatch::ATLAS_PADDING = 1;
+
+
+/*
+ *  SpriteBatch methods
+ *
+ */
+
+
+SpriteBatch::SpriteBatch()
+    : m_atlas(0), m_atlas_height(0), m_built(false), m_batches(0)
+{
+}
+
+
+SpriteBatch::~SpriteBatch()
+{
+    release_textures();
+}
+
+
+bool SpriteBatch::add(int surface, bool repeat)
+{
+    if(surface < 0)
+        return false;
+
+    if(SEarth::surface_Bpp(surface) != 3 && SEarth::surface_Bpp(surface) != 4) {
+        SEarth::error("Sprite images must be 24 or 32 bits\n");
+        return false;
+    }
+
+    Image& image = m_images[surface];
+    image.repeat = repeat;
+
+    // everything gets packed again on the next flush
+    m_built = false;
+    return true;
+}
+
+
+void SpriteBatch::draw(const Sprite& sprite)
+{
+    std::map<int, Image>::const_iterator it = m_images.find(sprite.surface);
+    if(it == m_images.end())
+        return;
+
+    Quad quad;
+    quad.order = m_quads.size();
+    quad.blend = sprite.blend;
+
+    // the atlas may not be built yet, so this holds
+    // the surface until flush() swaps in its texture
+    quad.texture = sprite.surface;
+
+    const float angle = DEG_RAD(sprite.angle);
+    const float c = std::cos(angle), s = std::sin(angle);
+
+    // counter-clockwise from the bottom left
+    const float corners[8] = {
+        sprite.left, sprite.bottom,
+        sprite.right, sprite.bottom,
+        sprite.right, sprite.top,
+        sprite.left, sprite.top
+    };
+
+    for(int i=0; i<4; ++i) {
+        const float x = corners[i * 2], y = corners[(i * 2) + 1];
+        quad.vertices[i * 2] = sprite.x + (x * c) - (y * s);
+        quad.vertices[(i * 2) + 1] = sprite.y + (x * s) + (y * c);
+    }
+
+    // image space for now, the top row is t = 0
+    quad.texcoords[0] = 0.0f;     quad.texcoords[1] = sprite.t;
+    quad.texcoords[2] = sprite.s; quad.texcoords[3] = sprite.t;
+    quad.texcoords[4] = sprite.s; quad.texcoords[5] = 0.0f;
+    quad.texcoords[6] = 0.0f;     quad.texcoords[7] = 0.0f;
+
+    quad.color[0] = static_cast<Uint8>(sprite.r * 255.0f);
+    quad.color[1] = static_cast<Uint8>(sprite.g * 255.0f);
+    quad.color[2] = static_cast<Uint8>(sprite.b * 255.0f);
+    quad.color[3] = 255;
+
+    m_quads.push_back(quad);
+}
+
+
+void SpriteBatch::draw(int surface, float x, float y, Blend blend)
+{
+    if(surface < 0)
+        return;
+
+    Sprite sprite(surface, x, y, SEarth::surface_width(surface), SEarth::surface_height(surface));
+    sprite.blend = blend;
+    draw(sprite);
+}
+
+
+void SpriteBatch::flush(int x, int y, int width, int height)
+{
+    m_batches = 0;
+    if(m_quads.empty())
+        return;
+
+    if(!m_built && !build()) {
+        m_quads.clear();
+        return;
+    }
+
+    // swap the surfaces for their textures and
+    // move the texture coordinates into the atlas
+    for(std::vector<Quad>::iterator quad = m_quads.begin(); quad != m_quads.end(); ++quad) {
+        const Image& image = m_images[quad->texture];
+        quad->texture = image.texture;
+
+        for(int i=0; i<4; ++i) {
+            quad->texcoords[i * 2] = image.s1 + (quad->texcoords[i * 2] * (image.s2 - image.s1));
+            quad->texcoords[(i * 2) + 1] = image.t1 + (quad->texcoords[(i * 2) + 1] * (image.t2 - image.t1));
+        }
+    }
+
+    // order is the last key, so sprites sharing state
+    // still draw in the order they were queued
+    std::sort(m_quads.begin(), m_quads.end());
+
+    // clear() keeps the capacity
+    m_vertices.clear();
+    m_texcoords.clear();
+    m_colors.clear();
+
+    for(std::vector<Quad>::const_iterator quad = m_quads.begin(); quad != m_quads.end(); ++quad) {
+        m_vertices.insert(m_vertices.end(), quad->vertices, quad->vertices + 8);
+        m_texcoords.insert(m_texcoords.end(), quad->texcoords, quad->texcoords + 8);
+        for(int i=0; i<4; ++i)
+            m_colors.insert(m_colors.end(), quad->color, quad->color + 4);
+    }
+
+    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    if(depth_test)
+        glDisable(GL_DEPTH_TEST);
+
+    const GLboolean blend = glIsEnabled(GL_BLEND);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+        glLoadIdentity();
+
+        gluOrtho2D(x, x + width, y, y + height);
+
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+            glLoadIdentity();
+
+            glNormal3f(0.0f, 0.0f, 1.0f);
+
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+            glEnableClientState(GL_COLOR_ARRAY);
+
+            glVertexPointer(2, GL_FLOAT, 0, &m_vertices[0]);
+            glTexCoordPointer(2, GL_FLOAT, 0, &m_texcoords[0]);
+            glColorPointer(4, GL_UNSIGNED_BYTE, 0, &m_colors[0]);
+
+            // one draw per run of the same blend and texture
+            unsigned int first = 0;
+            while(first < m_quads.size()) {
+                const Quad& run = m_quads[first];
+
+                unsigned int last = first + 1;
+                while(last < m_quads.size() && m_quads[last].blend == run.blend && m_quads[last].texture == run.texture)
+                    ++last;
+
+                if(BlendNone == run.blend)
+                    glDisable(GL_BLEND);
+                else if(blend)
+                    glEnable(GL_BLEND);
+
+                glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(run.texture));
+                glDrawArrays(GL_QUADS, first * 4, (last - first) * 4);
+                ++m_batches;
+
+                first = last;
+            }
+
+            glDisableClientState(GL_COLOR_ARRAY);
+            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+            glDisableClientState(GL_VERTEX_ARRAY);
+
+            // the color is undefined after drawing from a color array
+            glColor3f(1.0f, 1.0f, 1.0f);
+
+        glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+
+    glMatrixMode(GL_MODELVIEW);
+
+    if(blend)
+        glEnable(GL_BLEND);
+
+    if(depth_test)
+        glEnable(GL_DEPTH_TEST);
+
+    m_quads.clear();
+}
+
+
+bool SpriteBatch::build()
+{
+    release_textures();
+
+    // shelf pack everything that doesn't repeat, tallest first
+    std::vector<std::pair<int, int> > packing;
+    for(std::map<int, Image>::iterator it = m_images.begin(); it != m_images.end(); ++it) {
+        // anything too wide for the atlas goes on its own like a repeating image
+        if(!it->second.repeat && SEarth::surface_width(it->first) + ATLAS_PADDING <= ATLAS_WIDTH)
+            packing.push_back(std::make_pair(SEarth::surface_height(it->first), it->first));
+        else
+            it->second.repeat = true;
+    }
+    std::stable_sort(packing.begin(), packing.end(), taller);
+
+    std::vector<std::pair<int, int> > positions(packing.size());
+
+    int x = 0, y = 0, shelf = 0;
+    for(unsigned int i=0; i<packing.size(); ++i) {
+        const int surface = packing[i].second;
+        const int w = SEarth::surface_width(surface), h = SEarth::surface_height(surface);
+
+        if(x + w + ATLAS_PADDING > ATLAS_WIDTH) {
+            x = 0;
+            y += shelf;
+            shelf = 0;
+        }
+
+        positions[i] = std::make_pair(x, y);
+
+        x += w + ATLAS_PADDING;
+        shelf = std::max(shelf, h + ATLAS_PADDING);
+    }
+
+    m_atlas_height = 1;
+    while(m_atlas_height < y + shelf)
+        m_atlas_height <<= 1;
+
+    // copy them into one transparent BGRA image
+    if(!packing.empty()) {
+        std::vector<Uint8> pixels(ATLAS_WIDTH * m_atlas_height * 4, 0);
+        for(unsigned int i=0; i<packing.size(); ++i) {
+            const int surface = packing[i].second;
+            const int w = SEarth::surface_width(surface), h = SEarth::surface_height(surface);
+            const int Bpp = SEarth::surface_Bpp(surface);
+            const Uint8* const src = static_cast<const Uint8*>(SEarth::surface_pixels(surface));
+
+            const int ax = positions[i].first, ay = positions[i].second;
+            for(int row=0; row<h; ++row) {
+                Uint8* const dst = &pixels[(((ay + row) * ATLAS_WIDTH) + ax) * 4];
+                if(4 == Bpp)
+                    std::memcpy(dst, src + (row * w * 4), w * 4);
+                else {
+                    for(int col=0; col<w; ++col) {
+                        std::memcpy(dst + (col * 4), src + (((row * w) + col) * 3), 3);
+                        dst[(col * 4) + 3] = 255;
+                    }
+                }
+            }
+
+            Image& image = m_images[surface];
+            image.s1 = static_cast<float>(ax) / ATLAS_WIDTH;
+            image.t1 = static_cast<float>(ay) / m_atlas_height;
+            image.s2 = static_cast<float>(ax + w) / ATLAS_WIDTH;
+            image.t2 = static_cast<float>(ay + h) / m_atlas_height;
+        }
+
+        // the atlas keeps its texture across rebuilds
+        m_atlas = TextureCache::create("sprite atlas", ATLAS_WIDTH, m_atlas_height, GL_BGRA, &pixels[0]);
+
+        for(unsigned int i=0; i<packing.size(); ++i)
+            m_images[packing[i].second].texture = m_atlas;
+
+        SEarth::log("Built %dx%d sprite atlas from %d images\n", ATLAS_WIDTH, m_atlas_height, static_cast<int>(packing.size()));
+    }
+
+    // the rest get a texture each
+    for(std::map<int, Image>::iterator it = m_images.begin(); it != m_images.end(); ++it) {
+        Image& image = it->second;
+        if(!image.repeat)
+            continue;
+
+        image.texture = TextureCache::acquire(it->first);
+
+        image.s1 = image.t1 = 0.0f;
+        image.s2 = image.t2 = 1.0f;
+    }
+
+    // anything the old build had that this one doesn't
+    TextureCache::purge();
+
+    m_built = true;
+    return true;
+}
+
+
+void SpriteBatch::release_textures()
+{
+    for(std::map<int, Image>::iterator it = m_images.begin(); it != m_images.end(); ++it) {
+        Image& image = it->second;
+        if(image.texture != m_atlas)
+            TextureCache::release(image.texture);
+        image.texture = 0;
+    }
+
+    TextureCache::release(m_atlas);
+    m_atlas = 0;
+}
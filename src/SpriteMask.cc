@@ -0,0 +1,54 @@
+/*
+====================
+File: SpriteMask.cc
+Author: Shane Lillie
+Description: Sprite collision mask source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#include "SpriteMask.h"
+#include "SEarth.h"
+
+
+/*
+ *  SpriteMask methods
+ *
+ */
+
+
+SpriteMask::SpriteMask(int surface)
+    : m_bits(SEarth::surface_width(surface), SEarth::surface_height(surface)),
+        m_first_clear(SEarth::surface_width(surface), SEarth::surface_height(surface))
+{
+    const Uint32 black = SEarth::map_rgba(surface, 0, 0, 0, 0);
+
+    SEarth::lock_surface(surface);
+
+    for(int x=0; x<width(); ++x) {
+        for(int y=0; y<height(); ++y) {
+            if(SEarth::pixel(surface, x, y) != black)
+                m_bits.set(x, y);
+            else if(m_first_clear[x] == height())
+                m_first_clear[x] = y;
+        }
+    }
+
+    SEarth::unlock_surface(surface);
+}
@@ -0,0 +1,151 @@
+/*
+====================
+File: Tanks.cc
+Author: Shane Lillie
+Description: Tank store source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+
+#include "Tanks.h"
+#include "SpriteMask.h"
+#include "Terrain.h"
+
+
+/*
+ *  Tanks methods
+ *
+ */
+
+
+Tanks::Tanks()
+{
+}
+
+
+Tanks::~Tanks()
+{
+}
+
+
+void Tanks::add(const Vector3<float>& pos)
+{
+    m_x.push_back(pos.x());
+    m_y.push_back(pos.y());
+    m_prev_x.push_back(pos.x());
+    m_prev_y.push_back(pos.y());
+    m_vx.push_back(0.0f);
+    m_vy.push_back(0.0f);
+    m_next_x.push_back(pos.x());
+    m_next_y.push_back(pos.y());
+    m_resting.push_back(0);
+    m_rested_at.push_back(0);
+}
+
+
+void Tanks::update(const Terrain& terrain, const SpriteMask& mask, float elapsed_sec)
+{
+    const int n = count();
+
+    /* -190 is gravity */
+    const float half_dv = (-190.0f / 2.0f) * elapsed_sec;
+    const float dv = -190.0f * elapsed_sec;
+
+    // anything that changed under a resting tank might drop it
+    for(int i=0; i<n; ++i) {
+        m_prev_x[i] = m_x[i];
+        m_prev_y[i] = m_y[i];
+
+        if(m_resting[i]) {
+            const int x = static_cast<int>(m_x[i]);
+            if(terrain.changed_since(x, x + mask.width() - 1, m_rested_at[i]))
+                m_resting[i] = 0;
+        }
+    }
+
+    // integrate the awake ones in one pass
+    for(int i=0; i<n; ++i) {
+        if(m_resting[i])
+            continue;
+
+        m_next_x[i] = m_x[i] + (m_vx[i] * elapsed_sec);
+        m_next_y[i] = m_y[i] + ((m_vy[i] + half_dv) * elapsed_sec);
+    }
+
+    // then sweep them against the terrain
+    for(int i=0; i<n; ++i) {
+        if(m_resting[i])
+            continue;
+
+        const Vector3<float> pos(m_x[i], m_y[i], 0.0f);
+        const Vector3<float> next(m_next_x[i], m_next_y[i], 0.0f);
+
+        // the velocity is only used to back out of the ground,
+        // and that's the average over the step
+        const Vector3<float> vavg(m_vx[i], m_vy[i] + half_dv, 0.0f);
+        m_vy[i] += dv;
+
+        Vector3<float> rest;
+        if(!terrain.collision(pos, next, vavg, &rest, mask)) {
+            m_x[i] = next.x();
+            m_y[i] = next.y();
+            continue;
+        }
+
+        m_x[i] = rest.x();
+        m_y[i] = rest.y();
+        m_vx[i] = m_vy[i] = 0.0f;
+
+        // we hit the ground, but is it enough?
+        const int slide = terrain.would_fall(static_cast<int>(m_x[i]), static_cast<int>(m_y[i]), mask);
+        m_x[i] += slide;
+
+        if(!slide) {
+            m_resting[i] = 1;
+            m_rested_at[i] = terrain.changes();
+        }
+    }
+}
+
+
+void Tanks::clear()
+{
+    m_x.clear();
+    m_y.clear();
+    m_prev_x.clear();
+    m_prev_y.clear();
+    m_vx.clear();
+    m_vy.clear();
+    m_next_x.clear();
+    m_next_y.clear();
+    m_resting.clear();
+    m_rested_at.clear();
+}
+
+
+int Tanks::awake() const
+{
+    int awake = 0;
+    for(int i=0; i<count(); ++i) {
+        if(!m_resting[i])
+            ++awake;
+    }
+    return awake;
+}
@@ -23,247 +23,386 @@ Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
 
+#include <algorithm>
 #include <cassert>
+#include <cfloat>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <string>
-#include <fstream>
-
-#include <errno.h>
 
 #include "SDL_opengl.h"
 
 #include "Terrain.h"
-#include "SEarth.h"
+#include "TerrainFile.h"
+#include "JobPool.h"
+#include "SpriteMask.h"
+#include "Timeline.h"
 #include "Vector.h"
-#include "utilities.h"
 
 
 /*
- *  external globals
+ *  functions
  *
  */
 
 
-extern int errno;
+// packs an RGBA color into a pixel of the color buffer
+// (bytes in memory are R, G, B, A, whatever the byte order)
+Uint32 rgba_pixel(const Uint8* color)
+{
+    Uint32 pixel;
+    std::memcpy(&pixel, color, sizeof(pixel));
+    return pixel;
+}
 
 
 /*
- *  Terrain methods
+ *  CellWalk class
+ *
+ *  walks every cell a line touches exactly once (supercover DDA)
  *
  */
 
 
-Terrain::Terrain(const std::string& filename, int width, int height) throw(TerrainException)
-    : m_terrain(NULL), m_width(width), m_height(height)
+class CellWalk
 {
-    m_textures[0] = m_textures[1] = m_textures[2] = 0;
-    m_surfaces[0] = m_surfaces[1] = m_surfaces[2] = -1;
+public:
+    CellWalk(const Vector3<float>& a, const Vector3<float>& b)
+        : m_start(a), m_axis(-1), m_t(0.0f)
+    {
+        m_x = static_cast<int>(std::floor(a.x()));
+        m_y = static_cast<int>(std::floor(a.y()));
+
+        m_dx = b.x() - a.x();
+        m_dy = b.y() - a.y();
 
-    std::ifstream infile(filename.c_str());
-    if(!infile)
-        throw TerrainException(std::string("Could not open terrain file: ") + std::strerror(errno));
+        m_sx = m_dx > 0.0f ? 1 : (m_dx < 0.0f ? -1 : 0);
+        m_sy = m_dy > 0.0f ? 1 : (m_dy < 0.0f ? -1 : 0);
 
-    m_terrain = new bool*[m_width];
-    for(int i=0; i<m_width; ++i) {
-        m_terrain[i] = new bool[m_height];
-        std::memset(m_terrain[i], 0, m_height * sizeof(bool));
+        m_nx = std::abs(static_cast<int>(std::floor(b.x())) - m_x);
+        m_ny = std::abs(static_cast<int>(std::floor(b.y())) - m_y);
+
+        // parametric distance to the first boundary on each axis
+        m_tx = m_sx ? ((m_sx > 0 ? m_x + 1 : m_x) - a.x()) / m_dx : FLT_MAX;
+        m_ty = m_sy ? ((m_sy > 0 ? m_y + 1 : m_y) - a.y()) / m_dy : FLT_MAX;
+
+        m_tdx = m_sx ? 1.0f / std::fabs(m_dx) : FLT_MAX;
+        m_tdy = m_sy ? 1.0f / std::fabs(m_dy) : FLT_MAX;
     }
 
-    int x = 0;
-    while(!infile.eof() && x < m_width) {
-        int y = 0;
-        infile >> y;
-
-        // out texture is only this high for now
-        if(y >= 512/*m_height*/)
-            y = 511/*m_height-1*/;
-        else if(y < 0)
-            y = 0;
-
-        skip_whitespace(infile);
-
-        char ch = infile.get();
-        if(ch == ',') {
-            int count = 0;
-            infile >> count;
-
-            if(count && count > 0) {
-                int total = x + count;
-                if(total > m_width)
-                    total = m_width;
-
-                for(int i=y; i>=0; --i)
-                    for(int j=x; j<total; ++j)
-                        m_terrain[j][i] = true;
-                x = total;
-            }
-        } else if(ch == 'r') {
-            int top = 0;
-            infile >> top;
+public:
+    // moves into the next cell
+    // returns false once the end cell has been visited
+    bool step()
+    {
+        if(m_nx > 0 && (m_ny <= 0 || m_tx <= m_ty)) {
+            m_t = m_tx;
+            m_tx += m_tdx;
+            m_x += m_sx;
+            --m_nx;
+            m_axis = 0;
+            return true;
+        } else if(m_ny > 0) {
+            m_t = m_ty;
+            m_ty += m_tdy;
+            m_y += m_sy;
+            --m_ny;
+            m_axis = 1;
+            return true;
+        }
+        return false;
+    }
 
-            int step = 1;
+    int x() const { return m_x; }
+    int y() const { return m_y; }
 
-            skip_whitespace(infile);
+    int step_x() const { return m_sx; }
+    int step_y() const { return m_sy; }
 
-            ch = infile.get();
-            if(ch == ',')
-                infile >> step;
-            else
-                infile.putback(ch);
+    // which axis the last step was along (0 = x, 1 = y)
+    int axis() const { return m_axis; }
 
-            const int y_count = top - y;
-            if(y_count < 0 && step > 0 || y_count > 0 && step < 0)
-                step *= -1;
+    // the point on the line just before it entered the current cell
+    Vector3<float> last_free(float z) const
+    {
+        float x = m_start.x() + (m_dx * m_t);
+        float y = m_start.y() + (m_dy * m_t);
 
-            int total = x + (std::abs(y_count) / std::abs(step));
-            for(int i=x; i<total; ++i) {
-                for(int j=y; j>=0; --j)
-                    m_terrain[i][j] = true;
-                y += step;
-            }
-            x = total;
-        } else {
-            infile.putback(ch);
+        // snap back into the previous cell on the axis we stepped along
+        // (entering from below means backing off just under the boundary)
+        if(m_axis == 0)
+            x = m_sx > 0 ? static_cast<float>(m_x) - .001f : static_cast<float>(m_x + 1);
+        else if(m_axis == 1)
+            y = m_sy > 0 ? static_cast<float>(m_y) - .001f : static_cast<float>(m_y + 1);
+        return Vector3<float>(x, y, z);
+    }
+
+private:
+    Vector3<float> m_start;
+    float m_dx, m_dy;
+
+    int m_x, m_y;
+    int m_sx, m_sy;
+    int m_nx, m_ny;
+    int m_axis;
+
+    float m_t, m_tx, m_ty, m_tdx, m_tdy;
+};
+
+
+/*
+ *  Terrain class constants
+ *
+ */
 
-            for(int i=y; i>=0; --i)
-                m_terrain[x][i] = true;
-            x++;
+
+const int Terrain::TILE_SIZE = 256;
+const Uint32 Terrain::CLEAR_PIXEL = 0;
+const int Terrain::SLIDE_GRAIN = 32;
+
+
+/*
+ *  Terrain methods
+ *
+ */
+
+
+Terrain::Terrain(const std::string& filename, int width, int height) throw(TerrainException)
+    : m_terrain(width, height), m_width(0), m_height(0), m_tiles_x(0), m_tiles_y(0),
+        m_slide_distance(0), m_fall(0.0f), m_ramp(TerrainFile::default_ramp()),
+        m_uploaded_bytes(0), m_changes(0)
+{
+    try {
+        if(TerrainFile::is_binary(filename)) {
+            // mapped, so the bitmap is just copied out
+            // and the map is whatever size the file was made at
+            TerrainFile file(filename);
+            resize(file.width(), file.height());
+
+            file.copy_bitmap(m_terrain);
+            if(file.ramp_size() > 0)
+                m_ramp.assign(file.ramp(), file.ramp() + (file.ramp_size() * 4));
+        } else {
+            // a .set doesn't say how big it is
+            resize(width, height);
+            TerrainFile::parse_set(filename, m_terrain);
         }
+    } catch(TerrainFile::TerrainFileException& e) {
+        throw TerrainException(e.what());
     }
 
-    infile.clear();
-    infile.close();
+    for(int x=0; x<m_width; ++x)
+        m_tops[x] = m_terrain.top(x);
 
-    create_textures();
+    // the colors are filled in the first time we render,
+    // so a headless simulation never pays for them
 }
 
 
 Terrain::~Terrain()
 {
     delete_textures();
-    free_surfaces();
+}
 
-    if(m_terrain) {
-        for(int i=0; i<m_width; ++i)
-            delete[] m_terrain[i];
-        delete[] m_terrain;
-    }
+
+bool Terrain::collision(const Vector3<float>& s0, const Vector3<float>& s1, const Vector3<float>& v, Vector3<float>* const s2, const SpriteMask& mask) const
+{
+    return sweep(s0, s1, v, s2, mask.width(), mask.height(), &mask);
 }
 
 
-bool Terrain::collision(const Vector3<float>& s0, const Vector3<float>& s1, const Vector3<float>& v, Vector3<float>* const s2, int surface) const
+Terrain::Rect Terrain::deform(const Vector3<float>& pos, int radius)
 {
-    assert(m_terrain);
+    Timeline::Span span("Terrain::deform");
 
-    SEarth::lock_surface(surface);
+    const int cx = static_cast<int>(pos.x());
+    const int cy = static_cast<int>(pos.y());
+    const int r2 = radius * radius;
 
-    Vector3<float> pos(s0);
+    // bounding box of the crater, clipped to the map
+    const Rect crater(std::max(cx - radius, 0), std::max(cy - radius, 0),
+        std::min(cx + radius, m_width - 1), std::min(cy + radius, m_height - 1));
+    if(radius <= 0 || crater.empty())
+        return Rect();
 
-    bool ret = false;
-    do {
-        // break if we crossed the new position
-        // both x and y
-        if(((s0.x() <= s1.x() && pos.x() >= s1.x())  ||
-            (s0.x() >= s1.x() && pos.x() <= s1.x())) &&
-           ((s0.y() <= s1.y() && pos.y() >= s1.y()) ||
-            (s0.y() >= s1.y() && pos.y() <= s1.y())))
-            break;
+    ++m_changes;
+
+    // the bitmap is column-major, so clear one vertical span per column
+    for(int x=crater.x1; x<=crater.x2; ++x) {
+        const int dx = x - cx;
+        const int h = static_cast<int>(std::sqrt(static_cast<float>(r2 - (dx * dx))));
 
-        if(collision(pos, surface)) {
-            // move backward to non-collision spot
-            do pos -= v * .001f;
-            while(collision(pos, surface));
+        // with the center off the map, the edges
+        // of the circle can miss it completely
+        if(cy - h >= m_height || cy + h < 0)
+            continue;
 
-            if(s2) *s2 = pos;
+        m_terrain.clear_span(x, cy - h, cy + h);
+        m_changed[x] = m_changes;
 
-            ret = true;
-            break;
-        }
+        // only a hole through the top changes the surface
+        if(m_tops[x] <= cy + h)
+            m_tops[x] = m_terrain.top(x);
 
-        // test in ms
-        pos += v * .001f;
-    } while(true);
+        // anything above the hole may fall now
+        unsettle(x, std::max(cy - h, 0));
+    }
 
-    SEarth::unlock_surface(surface);
+    // the colors are row-major, so clear one horizontal span per row
+    if(colored()) {
+        for(int y=crater.y1; y<=crater.y2; ++y) {
+            const int dy = y - cy;
+            const int w = static_cast<int>(std::sqrt(static_cast<float>(r2 - (dy * dy))));
 
-    return ret;
+            // same as the columns, the ends of the
+            // row can miss the map with the center off it
+            if(cx + w < 0 || cx - w >= m_width)
+                continue;
+
+            clear_row(y, std::max(cx - w, 0), std::min(cx + w, m_width - 1));
+        }
+
+        mark_dirty(crater);
+    }
+    return crater;
 }
 
 
-void Terrain::deform(const Vector3<float>& pos, int radius)
+bool Terrain::slide(float elapsed_sec, JobPool* const jobs)
 {
-    assert(m_terrain);
+    Timeline::Span span("Terrain::slide");
 
-    m_last_deform_pos = pos;
-    m_last_deform_radius = radius + 1;  // plus one because we go from r=1 to r<=radius
+    if(m_unsettled.empty())
+        return false;
 
-    lock_surfaces();
+    /* 190 is gravity */
+    // carry the fraction of a row over to the next call,
+    // so how far the dirt falls doesn't depend on the step size
+    m_fall += 190.0f * elapsed_sec;
+
+    const int distance = static_cast<int>(m_fall);
+    if(distance <= 0)
+        return false;
+    m_fall -= distance;
+
+    // the columns don't touch each other,
+    // so they can be slid on any thread
+    m_slide_distance = distance;
+    m_slide_dirty.resize(m_unsettled.size());
+    if(jobs)
+        jobs->parallel_for(slide_columns, this, m_unsettled.size(), SLIDE_GRAIN);
+    else
+        slide_columns(this, 0, m_unsettled.size());
 
-    for(int angle=0; angle<360; ++angle) {
-        // note r=1..radius (inclusive)
-        for(int r=1; r<=radius; ++r) {
-            int x = static_cast<int>(pos.x() + (r * std::cos(DEG_RAD(angle))));
-            int y = static_cast<int>(pos.y() + (r * std::sin(DEG_RAD(angle))));
+    // then merge back here, keeping the columns that moved
+    bool ret = false;
+    ++m_changes;
 
-            if(x < 0)
-                x = 0;
-            else if(x >= m_width)
-                x = m_width-1;
+    unsigned int kept = 0;
+    for(unsigned int i=0; i<m_unsettled.size(); ++i) {
+        const int x = m_unsettled[i];
+        if(m_slide_dirty[i].empty()) {
+            m_slide_start[x] = m_height;
+            continue;
+        }
+        m_changed[x] = m_changes;
 
-            if(y < 0)
-                y = 0;
-            else if(y >= m_height)
-                y = m_height-1;
+        if(colored())
+            mark_dirty(m_slide_dirty[i]);
 
-            remove_point(x, y);
-        }
+        m_unsettled[kept++] = x;
+        ret = true;
     }
+    m_unsettled.resize(kept);
 
-    unlock_surfaces();
+    if(m_unsettled.empty())
+        m_fall = 0.0f;
 
-    // re-generate the textures
-    generate_textures();
+    return ret;
 }
 
 
-bool Terrain::slide(float elapsed_sec)
+void Terrain::slide_columns(void* data, int begin, int end)
 {
-    assert(m_terrain);
+    Terrain* const terrain = static_cast<Terrain*>(data);
 
-    const int x1 = static_cast<int>(m_last_deform_pos.x() - m_last_deform_radius);
-    const int x2 = static_cast<int>(m_last_deform_pos.x() + m_last_deform_radius);
+    for(int i=begin; i<end; ++i) {
+        const int x = terrain->m_unsettled[i];
+        terrain->m_slide_dirty[i] = terrain->slide(x, terrain->m_slide_start[x], terrain->m_slide_distance);
+    }
+}
 
-    const int xs = x1 < 0 ? 0 : x1;
-    const int xe = x2 >= m_width ? m_width - 1 : x2;
 
-    const int yt = static_cast<int>(m_last_deform_pos.y() - m_last_deform_radius);
-    const int ys = yt < 0 ? 0 : yt;
+void Terrain::deposit(const Vector3<float>& pos, int width, int height)
+{
+    const int x1 = std::max(static_cast<int>(std::floor(pos.x())), 0);
+    const int y1 = std::max(static_cast<int>(std::floor(pos.y())), 0);
+    const int x2 = std::min(static_cast<int>(std::floor(pos.x())) + width - 1, m_width - 1);
+    const int y2 = std::min(static_cast<int>(std::floor(pos.y())) + height - 1, m_height - 1);
+    if(x1 > x2 || y1 > y2)
+        return;
 
-    lock_surfaces();
+    const Uint32 color = rgba_pixel(&m_ramp[0]);
 
-    bool ret = false;
+    ++m_changes;
+    for(int x=x1; x<=x2; ++x) {
+        m_changed[x] = m_changes;
+
+        for(int y=y1; y<=y2; ++y) {
+            if(m_terrain.solid(x, y))
+                continue;
 
-    // only look at the points that were changed
-    for(int x=xs; x<xe; ++x)
-        if(slide(x, ys, elapsed_sec))
-            ret = true;
+            m_terrain.set(x, y);
+            if(colored())
+                *pixel_at(x, y) = color;
+        }
 
-    unlock_surfaces();
+        m_tops[x] = std::max(m_tops[x], y2);
 
-    // re-generate the textures
-    generate_textures();
+        // let it fall onto whatever is below
+        unsettle(x, y1);
+    }
 
-    return ret;
+    if(colored())
+        mark_dirty(Rect(x1, y1, x2, y2));
+}
+
+
+bool Terrain::changed_since(int x1, int x2, unsigned int change) const
+{
+    x1 = std::max(x1, 0);
+    x2 = std::min(x2, m_width - 1);
+    for(int x=x1; x<=x2; ++x) {
+        if(m_changed[x] > change)
+            return true;
+    }
+    return false;
+}
+
+
+void Terrain::unsettle(int x, int y)
+{
+    assert(x >= 0 && x < m_width);
+    assert(y >= 0 && y < m_height);
+
+    // already in the set, just widen it
+    if(m_slide_start[x] < m_height) {
+        m_slide_start[x] = std::min(m_slide_start[x], y);
+        return;
+    }
+
+    m_slide_start[x] = y;
+    m_unsettled.push_back(x);
 }
 
 
 void Terrain::render()
 {
-    assert(m_terrain);
+    if(!colored())
+        color();
 
-    if(!m_textures[0] || !m_textures[1] || !m_textures[2])
-        create_textures();
+    update_textures();
 
     const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
     if(depth_test)
@@ -273,7 +412,7 @@ void Terrain::render()
     glPushMatrix();
         glLoadIdentity();
 
-        gluOrtho2D(0.0f, m_width, 0.0f, m_height);
+        gluOrtho2D(m_view.x1, m_view.x2 + 1, m_view.y1, m_view.y2 + 1);
 
         glMatrixMode(GL_MODELVIEW);
         glPushMatrix();
@@ -282,32 +421,25 @@ void Terrain::render()
             //glColor3f(1.0f, 1.0f, 1.0f);
             glNormal3f(0.0f, 0.0f, 1.0f);
 
-            glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(m_textures[0]));
-
-            glBegin(GL_QUADS);
-                glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, 0.0f);
-                glTexCoord2f(1.0f, 0.0f); glVertex2f(511.0f, 0.0f);
-                glTexCoord2f(1.0f, 1.0f); glVertex2f(511.0f, 511.0f);
-                glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, 511.0f);
-            glEnd();
-
-            glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(m_textures[1]));
-
-            glBegin(GL_QUADS);
-                glTexCoord2f(0.0f, 0.0f); glVertex2f(511.0f, 0.0f);
-                glTexCoord2f(1.0f, 0.0f); glVertex2f(767.0f, 0.0f);
-                glTexCoord2f(1.0f, 1.0f); glVertex2f(767.0f, 511.0f);
-                glTexCoord2f(0.0f, 1.0f); glVertex2f(511.0f, 511.0f);
-            glEnd();
-
-            glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(m_textures[2]));
-
-            glBegin(GL_QUADS);
-                glTexCoord2f(0.0f, 0.0f); glVertex2f(767.0f, 0.0f);
-                glTexCoord2f(1.0f, 0.0f); glVertex2f(799.0f, 0.0f);
-                glTexCoord2f(1.0f, 1.0f); glVertex2f(799.0f, 511.0f);
-                glTexCoord2f(0.0f, 1.0f); glVertex2f(767.0f, 511.0f);
-            glEnd();
+            // only draw the tiles we can see
+            const Rect visible(visible_tiles());
+            for(int ty=visible.y1; ty<=visible.y2; ++ty) {
+                for(int tx=visible.x1; tx<=visible.x2; ++tx) {
+                    const GLfloat x1 = static_cast<GLfloat>(tx * TILE_SIZE);
+                    const GLfloat y1 = static_cast<GLfloat>(ty * TILE_SIZE);
+                    const GLfloat x2 = x1 + TILE_SIZE;
+                    const GLfloat y2 = y1 + TILE_SIZE;
+
+                    glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(tile(tx, ty).texture));
+
+                    glBegin(GL_QUADS);
+                        glTexCoord2f(0.0f, 0.0f); glVertex2f(x1, y1);
+                        glTexCoord2f(1.0f, 0.0f); glVertex2f(x2, y1);
+                        glTexCoord2f(1.0f, 1.0f); glVertex2f(x2, y2);
+                        glTexCoord2f(0.0f, 1.0f); glVertex2f(x1, y2);
+                    glEnd();
+                }
+            }
 
         glPopMatrix();
     glMatrixMode(GL_PROJECTION);
@@ -318,75 +450,91 @@ void Terrain::render()
 }
 
 
+void Terrain::set_view(int x, int y, int width, int height)
+{
+    m_view = Rect(x, y, x + width - 1, y + height - 1);
+}
+
+
 bool Terrain::collision(const Vector3<float>& s0, const Vector3<float>& s1, const Vector3<float>& v, Vector3<float>* const s2, int width, int height) const
 {
-    assert(m_terrain);
-
-    Vector3<float> pos(s0);
-    do {
-        // break if we crossed the new position
-        // both x and y
-        if(((s0.x() <= s1.x() && pos.x() >= s1.x())  ||
-            (s0.x() >= s1.x() && pos.x() <= s1.x())) &&
-           ((s0.y() <= s1.y() && pos.y() >= s1.y()) ||
-            (s0.y() >= s1.y() && pos.y() <= s1.y())))
-            break;
+    // most things are up in the air, so try the column tops first
+    if(above_ground(s0, s1, width))
+        return false;
+    return sweep(s0, s1, v, s2, width, height, NULL);
+}
 
-        if(collision(pos, width, height)) {
-            // move backward to non-collision spot
-            do pos -= v * .001f;
-            while(collision(pos, width, height));
 
-            if(s2) *s2 = pos;
-            return true;
-        }
+void Terrain::generate_textures()
+{
+    Timeline::Span span("Terrain::generate_textures");
 
-        // test in ms
-        pos += v * .001f;
-    } while(true);
-    return false;
+    if(!colored())
+        color();
+
+    for(int ty=0; ty<m_tiles_y; ++ty)
+        for(int tx=0; tx<m_tiles_x; ++tx)
+            upload_tile(tx, ty, true);
 }
 
 
-void Terrain::generate_textures()
+void Terrain::update_textures()
 {
-    if(m_surfaces[0] < 0 || m_surfaces[1] < 0 || m_surfaces[2] < 0)
-        create_textures();
+    // dirty tiles outside the view keep their dirty area
+    // until they scroll into view
+    const Rect visible(visible_tiles());
+    for(int ty=visible.y1; ty<=visible.y2; ++ty)
+        for(int tx=visible.x1; tx<=visible.x2; ++tx)
+            upload_tile(tx, ty, false);
+}
 
-    if(m_textures[0] || m_textures[1] || m_textures[2])
-        delete_textures();
 
-    // generate 3 textures
-    glGenTextures(3, static_cast<GLuint*>(m_textures));
+void Terrain::upload_tile(int tx, int ty, bool full)
+{
+    Tile& current = tile(tx, ty);
+    const Uint32* const pixels = tile_pixels(tx, ty);
 
-    /* create the textures */
+    if(!current.texture) {
+        glGenTextures(1, static_cast<GLuint*>(&current.texture));
 
-    glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(m_textures[0]));
+        glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(current.texture));
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 512, 512, 0, GL_RGBA, GL_UNSIGNED_BYTE, SEarth::surface_pixels(m_surfaces[0]));
+        full = true;
+    } else if(!full && current.dirty.empty())
+        return;
+    else
+        glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(current.texture));
 
-    glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(m_textures[1]));
+    if(full) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, TILE_SIZE, TILE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        m_uploaded_bytes += TILE_SIZE * TILE_SIZE * 4;
+    } else {
+        const Rect& dirty = current.dirty;
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        // upload just the dirty rows/columns straight out of the colors
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, TILE_SIZE);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, dirty.x1);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, dirty.y1);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, 512, 0, GL_RGBA, GL_UNSIGNED_BYTE, SEarth::surface_pixels(m_surfaces[1]));
+        glTexSubImage2D(GL_TEXTURE_2D, 0, dirty.x1, dirty.y1, dirty.width(), dirty.height(),
+            GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 
-    glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(m_textures[2]));
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        m_uploaded_bytes += dirty.width() * dirty.height() * 4;
+    }
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 32, 512, 0, GL_RGBA, GL_UNSIGNED_BYTE, SEarth::surface_pixels(m_surfaces[2]));
+    current.dirty = Rect();
 }
 
 
-int Terrain::would_fall(int x, int y, int surface)
+int Terrain::would_fall(int x, int y, const SpriteMask& mask) const
 {
-    assert(m_terrain);
     assert(x >= 0 && x < m_width);
     assert(y >= 0 && y < m_height);
 
@@ -394,20 +542,13 @@ int Terrain::would_fall(int x, int y, int surface)
     if(y <= 0)
         return 0;
 
-    const Uint32 black = SEarth::map_rgba(surface, 0, 0, 0, 0);
-    const int xe = x + SEarth::surface_width(surface) >= m_width ? m_width : x + SEarth::surface_width(surface);
+    const int width = mask.width();
+    const int xe = x + width >= m_width ? m_width : x + width;
 
-    int left = 0, t=0;
+    // look one below the first clear pixel of each column
+    int left = 0;
     for(int i=x; i<xe; ++i) {
-        // figure out where bottom pixel of surface is
-        t=-1;
-        while(t < SEarth::surface_height(surface)) {
-            if(SEarth::pixel(surface, i-x, ++t) == black)
-                break;
-        }
-
-        // look one below that pixel
-        if(m_terrain[i][y + t - 1])
+        if(m_terrain.solid(i, y + mask.first_clear(i - x) - 1))
             break;
         else
             ++left;
@@ -415,294 +556,299 @@ int Terrain::would_fall(int x, int y, int surface)
 
     int right = 0;
     for(int i=xe-1; i>=x; --i) {
-        // figure out where bottom pixel of surface is
-        t=-1;
-        while(t < SEarth::surface_height(surface)) {
-            if(SEarth::pixel(surface, i - x, ++t) == black)
-                break;
-        }
-
-        if(m_terrain[i][y + t - 1])
+        if(m_terrain.solid(i, y + mask.first_clear(i - x) - 1))
             break;
         else
             ++right;
     }
 
-    const int half_width = SEarth::surface_width(surface) / 2;
+    const int half_width = width / 2;
 
-    if(left >= SEarth::surface_width(surface) || right >= SEarth::surface_width(surface))
+    if(left >= width || right >= width)
         // gravity should drop us
         return 0;
     else if(left > right)
-        return left > half_width ? -(SEarth::surface_width(surface) - left) : 0;
-    return  right > half_width ? SEarth::surface_width(surface) - right : 0;
+        return left > half_width ? -(width - left) : 0;
+    return  right > half_width ? width - right : 0;
 }
 
 
-void Terrain::create_textures()
+void Terrain::color()
 {
-    if(m_surfaces[0] >= 0 || m_surfaces[1] >= 0 || m_surfaces[2] >= 0)
-        free_surfaces();
-
-    if(m_textures[0] || m_textures[1] || m_textures[2])
-        delete_textures();
+    // the tiles hang over the edge of the map,
+    // so start them all out transparent
+    m_pixels.assign(m_tiles.size() * TILE_SIZE * TILE_SIZE, CLEAR_PIXEL);
+    for(unsigned int i=0; i<m_tiles.size(); ++i)
+        m_tiles[i].dirty = Rect();
+
+    // pack the ramp once up front
+    std::vector<Uint32> ramp(m_ramp.size() / 4);
+    for(unsigned int i=0; i<ramp.size(); ++i)
+        ramp[i] = rgba_pixel(&m_ramp[i * 4]);
+
+    // copy over the pixels, walking down the ramp as we get deeper
+    for(int x=0; x<m_width; ++x) {
+        unsigned int color = 0;
 
-    m_surfaces[0] = SEarth::create_surface(512, 512, 32, "terrain1");
-    if(m_surfaces[0] < 0) return;
+        for(int y=m_terrain.top(x); y>=0; --y) {
+            if(m_terrain.solid(x, y)) {
+                *pixel_at(x, y) = ramp[color];
 
-    m_surfaces[1]= SEarth::create_surface(256, 512, 32, "terrain2");
-    if(m_surfaces[1] < 0) {
-        free_surfaces();
-        return;
+                if(color + 1 < ramp.size())
+                    color += 1;
+            }
+        }
     }
+}
 
-    m_surfaces[2] = SEarth::create_surface(32, 512, 32, "terrain3");
-    if(m_surfaces[2] < 0) {
-        free_surfaces();
-        return;
+
+void Terrain::delete_textures()
+{
+    for(unsigned int i=0; i<m_tiles.size(); ++i) {
+        if(m_tiles[i].texture)
+            glDeleteTextures(1, static_cast<GLuint*>(&m_tiles[i].texture));
+        m_tiles[i].texture = 0;
     }
+}
 
-    lock_surfaces();
 
-    // copy over the pixels
-    for(int x=0; x<m_width; ++x) {
-        int color = 0;
-
-        for(int y=511; y>=0; --y) {
-            int xf = 0;
-            int current = m_surfaces[0];
-
-            // choose the appropriate texture to write to
-            if(x >= 768) {
-                xf = 768;
-                current = m_surfaces[2];
-            } else if(x >= 512) {
-                xf = 512;
-                current = m_surfaces[1];
-            }
+Terrain::Rect Terrain::slide(int column, int start, int distance)
+{
+    assert(column >= 0 && column < m_width);
+    assert(start >= 0 && start < m_height);
+    assert(distance > 0);
 
+    // nothing above the start row
+    const int top = m_terrain.top(column);
+    if(top < start)
+        return Rect();
 
-            if(m_terrain[x][y]) {
-                // go brown as we get deeper
-                SEarth::pixel(current, x - xf, y, SEarth::map_rgba(current, color, 192 - color, 6, 255));
+    // the column is solid all the way down, nothing can fall
+    if(m_terrain.count_span(column, 0, top) == top + 1)
+        return Rect();
 
-                if(color < 128)
-                    color += 1;
-            } else
-                // make anything that's not terrain transparent
-                SEarth::pixel(current, x - xf, y, SEarth::map_rgba(current, 0, 0, 0, 0));
-        }
-    }
+    // everything lands on top of the highest point below the start row
+    int last = m_terrain.top_span(column, 0, start - 1);
 
-    unlock_surfaces();
+    TerrainBitmap::Word* const bits = m_terrain.column(column);
 
-    generate_textures();
-}
+    int lowest = m_height;
 
+    // one pass over the solid cells from the bottom up, a word at a time
+    // each cell falls at most distance, and no further than the cell below it
+    const int ws = start >> TerrainBitmap::WORD_SHIFT, we = top >> TerrainBitmap::WORD_SHIFT;
+    for(int w=ws; w<=we; ++w) {
+        TerrainBitmap::Word word = bits[w];
+        if(w == ws)
+            word &= TerrainBitmap::mask(start & TerrainBitmap::WORD_MASK, TerrainBitmap::WORD_MASK);
 
-void Terrain::delete_textures()
-{
-    if(m_textures[0])
-        glDeleteTextures(1, static_cast<GLuint*>(&m_textures[0]));
-    m_textures[0] = 0;
+        while(word) {
+            const int y = (w << TerrainBitmap::WORD_SHIFT) + TerrainBitmap::lowest_bit(word);
+            word &= word - 1;
 
-    if(m_textures[1])
-        glDeleteTextures(1, static_cast<GLuint*>(&m_textures[1]));
-    m_textures[1] = 0;
+            const int to = std::max(last + 1, y - distance);
+            last = to;
 
-    if(m_textures[2])
-        glDeleteTextures(1, static_cast<GLuint*>(&m_textures[2]));
-    m_textures[2] = 0;
-}
+            if(to == y)
+                continue;
 
+            // everything between to and y is empty,
+            // so this is a straight move
+            m_terrain.clear(column, y);
+            m_terrain.set(column, to);
 
-void Terrain::lock_surfaces()
-{
-    assert(m_surfaces[0] >= 0 && m_surfaces[1] >= 0 && m_surfaces[2] >= 0);
+            if(colored()) {
+                Uint32* const from = pixel_at(column, y);
+                *pixel_at(column, to) = *from;
+                *from = CLEAR_PIXEL;
+            }
+
+            if(to < lowest)
+                lowest = to;
+        }
+    }
+
+    if(lowest > top)
+        return Rect();
+
+    // the top cell is always the last one moved
+    m_tops[column] = last;
 
-    SEarth::lock_surface(m_surfaces[0]);
-    SEarth::lock_surface(m_surfaces[1]);
-    SEarth::lock_surface(m_surfaces[2]);
+    return Rect(column, lowest, column, top);
 }
 
 
-void Terrain::unlock_surfaces()
+bool Terrain::sweep(const Vector3<float>& s0, const Vector3<float>& s1, const Vector3<float>& v, Vector3<float>* const s2, int width, int height, const SpriteMask* const mask) const
 {
-    assert(m_surfaces[0] >= 0 && m_surfaces[1] >= 0 && m_surfaces[2] >= 0);
+    CellWalk walk(s0, s1);
+
+    // already in the ground, back out
+    if(mask ? hit(walk.x(), walk.y(), *mask) : hit(walk.x(), walk.y(), width, height)) {
+        unstick(s0, v, s2, width, height, mask);
+        return true;
+    }
 
-    SEarth::unlock_surface(m_surfaces[0]);
-    SEarth::unlock_surface(m_surfaces[1]);
-    SEarth::unlock_surface(m_surfaces[2]);
+    while(walk.step()) {
+        bool collided = false;
+        if(mask)
+            collided = hit(walk.x(), walk.y(), *mask);
+        else if(walk.axis() == 0)
+            // only the column we just moved into is new
+            collided = hit(walk.step_x() > 0 ? walk.x() + width - 1 : walk.x(), walk.y(), 1, height);
+        else
+            // only the row we just moved into is new
+            collided = hit(walk.x(), walk.step_y() > 0 ? walk.y() + height - 1 : walk.y(), width, 1);
+
+        if(collided) {
+            if(s2) *s2 = walk.last_free(s0.z());
+            return true;
+        }
+    }
+    return false;
 }
 
 
-void Terrain::free_surfaces()
+void Terrain::unstick(const Vector3<float>& s0, const Vector3<float>& v, Vector3<float>* const s2, int width, int height, const SpriteMask* const mask) const
 {
-    if(m_surfaces[0] >= 0)
-        SEarth::unload_surface(m_surfaces[0]);
-    m_surfaces[0] = -1;
-
-    if(m_surfaces[1] >= 0)
-        SEarth::unload_surface(m_surfaces[1]);
-    m_surfaces[1] = -1;
+    // walk back against the velocity (or up if we aren't moving)
+    // for at most the size of the footprint
+    const float distance = static_cast<float>(width + height);
+    const float length = v.length();
+
+    Vector3<float> back(s0.x(), s0.y() + distance, s0.z());
+    if(length > 0.0f)
+        back = s0 - (v * (distance / length));
+
+    CellWalk walk(s0, back);
+    while(walk.step()) {
+        if(!(mask ? hit(walk.x(), walk.y(), *mask) : hit(walk.x(), walk.y(), width, height))) {
+            if(s2) *s2 = Vector3<float>(static_cast<float>(walk.x()), static_cast<float>(walk.y()), s0.z());
+            return;
+        }
+    }
 
-    if(m_surfaces[2] >= 0)
-        SEarth::unload_surface(m_surfaces[2]);
-    m_surfaces[2] = -1;
+    // couldn't get out, stay put
+    if(s2) *s2 = s0;
 }
 
 
-bool Terrain::slide(int column, int start, float elapsed_sec)
+bool Terrain::above_ground(const Vector3<float>& s0, const Vector3<float>& s1, int width) const
 {
-    assert(m_terrain);
-    assert(column >= 0 && column < m_width);
-    assert(start >= 0 && start < m_height);
+    // box around the whole move
+    const int x1 = static_cast<int>(std::floor(std::min(s0.x(), s1.x())));
+    const int x2 = static_cast<int>(std::floor(std::max(s0.x(), s1.x()))) + width - 1;
+    const int y1 = static_cast<int>(std::floor(std::min(s0.y(), s1.y())));
+
+    // off the map is a hit, let the sweep handle it
+    if(x1 < 0 || x2 >= m_width - 1 || y1 < 0)
+        return false;
+
+    for(int x=x1; x<=x2; ++x)
+        if(m_tops[x] >= y1)
+            return false;
+    return true;
+}
 
-    /* 190 is gravity */
-    const int amt = static_cast<int>(std::ceil(190.0f * elapsed_sec));
 
-    bool ret = false;
-    for(int y=start; y<m_height; ++y) {
-        if(!m_terrain[column][y])
-            continue;
+bool Terrain::hit(int x, int y, const SpriteMask& mask) const
+{
+    if(x + mask.width() >= m_width || x < 0 || y < 0)
+        return true;
 
-        const int yt = y-amt;
-        const int ye = yt < 0 ? 0 : yt;
-
-        // find the first collision from the top down
-        for(int i=y-1; i>=ye; --i) {
-            if(m_terrain[column][i]) {
-                // if we hit a collision right off,
-                // we're done with this point
-                if(i == y-1)
-                    break;
-
-                swap_points(column, y, column, i+1);
-                ret = true;
-                break;
-            } else if(i == ye) {
-                // we didn't collide, so go all the way down
-                swap_points(column, y, column, ye);
-                ret = true;
-            }
+    // and each column of the mask with the terrain under it
+    for(int sx=0; sx<mask.width(); ++sx) {
+        const TerrainBitmap::Word* const bits = mask.column(sx);
+        for(int i=0; i<mask.words_per_column(); ++i) {
+            if(bits[i] & m_terrain.window(x + sx, y + (i << TerrainBitmap::WORD_SHIFT)))
+                return true;
         }
     }
-    return ret;
+    return false;
 }
 
 
-bool Terrain::collision(const Vector3<float>& pos, int surface) const
+bool Terrain::hit(int x, int y, int width, int height) const
 {
-    assert(m_terrain);
-
-    if((pos.x() + SEarth::surface_width(surface)) >= m_width || pos.x() < 0.0f || pos.y() < 0.0f)
+    if(x + width >= m_width || x < 0 || y < 0)
         return true;
 
-    const int yt = static_cast<int>(pos.y()) + SEarth::surface_height(surface) - 1;
+    for(int i=x; i<x+width; ++i)
+        if(m_terrain.any_span(i, y, y + height - 1))
+            return true;
+    return false;
+}
 
-    const int tys = yt >= m_height ? m_height-1 : yt;
-    const int ye = pos.y() < 0.0f ? 0 : static_cast<int>(pos.y());
 
-    const int sys = yt >= m_height ? yt - m_height - 1 : SEarth::surface_height(surface);
+void Terrain::resize(int width, int height)
+{
+    assert(width > 0 && height > 0);
 
-    const int xt = static_cast<int>(pos.x()) + SEarth::surface_width(surface) - 1;
+    // the bitmap starts out at the .set size
+    if(width != m_terrain.width() || height != m_terrain.height())
+        m_terrain = TerrainBitmap(width, height);
 
-    const int xs = pos.x() < 0.0f ? 0 : static_cast<int>(pos.x());
-    const int xe = xt >= m_width ? m_width-1 : xt;
+    m_width = width;
+    m_height = height;
 
-    for(int ty=tys, sy=sys; ty >= ye; --ty, --sy) {
-        for(int tx=xs, sx=0; tx<xe; ++tx, ++sx) {
-            // got pixel on the ground
-            if(m_terrain[tx][ty]) {
-                const Uint32 black = SEarth::map_rgba(surface, 0, 0, 0, 0);
-                const Uint32 pixel = SEarth::pixel(surface, sx, sy);
+    m_tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    m_tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    m_tiles.assign(m_tiles_x * m_tiles_y, Tile());
 
-                // got a pixel on the surface
-                if(pixel != black)
-                    return true;
-            }
-        }
-    }
-    return false;
+    m_view = Rect(0, 0, width - 1, height - 1);
+
+    m_slide_start.assign(width, height);
+    m_tops.assign(width, -1);
+    m_changed.assign(width, 0);
 }
 
 
-bool Terrain::collision(const Vector3<float>& pos, int width, int height) const
+void Terrain::clear_row(int y, int x1, int x2)
 {
-    assert(m_terrain);
-
-    if((pos.x() + width) >= m_width || pos.x() < 0.0f || pos.y() < 0.0f)
-        return true;
-
-    const int yt = static_cast<int>(pos.y()) + height - 1;
-
-    const int ys = yt > m_height ? m_height : yt;
-    const int ye = pos.y() < 0.0f ? 0 : static_cast<int>(pos.y());
+    assert(y >= 0 && y < m_height);
+    assert(x1 >= 0 && x2 < m_width);
 
-    const int xt = static_cast<int>(pos.x()) + width - 1;
+    if(x1 > x2)
+        return;
 
-    const int xs = pos.x() < 0.0f ? 0 : static_cast<int>(pos.x());
-    const int xe = xt > m_width ? m_width : xt;
+    for(int tx=x1 / TILE_SIZE; tx<=x2 / TILE_SIZE; ++tx) {
+        // part of the span that lands on this tile
+        const int xs = std::max(x1, tx * TILE_SIZE);
+        const int xe = std::min(x2, ((tx + 1) * TILE_SIZE) - 1);
 
-    for(int y=ys; y >= ye; --y)
-        for(int x=xs; x<xe; ++x)
-            if(m_terrain[x][y])
-                return true;
-    return false;
+        Uint32* const row = pixel_at(xs, y);
+        std::fill(row, row + (xe - xs) + 1, CLEAR_PIXEL);
+    }
 }
 
 
-void Terrain::remove_point(int x, int y)
+Uint32* Terrain::pixel_at(int x, int y)
 {
     assert(x >= 0 && x < m_width);
     assert(y >= 0 && y < m_height);
 
-    m_terrain[x][y] = false;
+    return tile_pixels(x / TILE_SIZE, y / TILE_SIZE) + ((y % TILE_SIZE) * TILE_SIZE) + (x % TILE_SIZE);
+}
 
-    if(x >= 768)
-        SEarth::pixel(m_surfaces[2], x - 768, y, SEarth::map_rgba(m_surfaces[2], 0, 0, 0, 0));
-    else if(x >= 512)
-        SEarth::pixel(m_surfaces[1], x - 512, y, SEarth::map_rgba(m_surfaces[1], 0, 0, 0, 0));
-    else
-        SEarth::pixel(m_surfaces[0], x, y, SEarth::map_rgba(m_surfaces[0], 0, 0, 0, 0));
+
+Terrain::Rect Terrain::visible_tiles() const
+{
+    return Rect(std::max(m_view.x1, 0) / TILE_SIZE, std::max(m_view.y1, 0) / TILE_SIZE,
+        std::min(m_view.x2, m_width - 1) / TILE_SIZE, std::min(m_view.y2, m_height - 1) / TILE_SIZE);
 }
 
 
-void Terrain::swap_points(int x1, int y1, int x2, int y2)
+void Terrain::mark_dirty(const Rect& rect)
 {
-    assert(x1 >= 0 && x1 < m_width);
-    assert(y1 >= 0 && y1 < m_height);
-    assert(x2 >= 0 && x2 < m_width);
-    assert(y2 >= 0 && y2 < m_height);
-
-    // swap in the terrain
-    const bool temp = m_terrain[x1][y1];
-    m_terrain[x1][y1] = m_terrain[x2][y2];
-    m_terrain[x2][y2] = temp;
-
-    /* swap on the surfaces */
-
-    int s1 = m_surfaces[0];
-    int xoff1 = 0;
-    if(x1 >= 768) {
-        s1 = m_surfaces[2];
-        xoff1 = 768;
-    } else if(x1 >= 512) {
-        s1 = m_surfaces[1];
-        xoff1 = 512;
-    }
+    if(rect.empty())
+        return;
 
-    int s2 = m_surfaces[0];
-    int xoff2 = 0;
-    if(x2 >= 768) {
-        s2 = m_surfaces[2];
-        xoff2 = 768;
-    } else if(x2 >= 512) {
-        s2 = m_surfaces[1];
-        xoff2 = 512;
-    }
+    // only touch the tiles the area covers
+    for(int ty=rect.y1 / TILE_SIZE; ty<=rect.y2 / TILE_SIZE; ++ty) {
+        for(int tx=rect.x1 / TILE_SIZE; tx<=rect.x2 / TILE_SIZE; ++tx) {
+            const int x = tx * TILE_SIZE, y = ty * TILE_SIZE;
 
-    Uint32 pixel = SEarth::pixel(s1, x1 - xoff1, y1);
-    SEarth::pixel(s1, x1 - xoff1, y1, SEarth::pixel(s2, x2 -xoff2, y2));
-    SEarth::pixel(s2, x2 - xoff2, y2, pixel);
+            tile(tx, ty).dirty.extend(Rect(std::max(rect.x1, x) - x, std::max(rect.y1, y) - y,
+                std::min(rect.x2, x + TILE_SIZE - 1) - x, std::min(rect.y2, y + TILE_SIZE - 1) - y));
+        }
+    }
 }
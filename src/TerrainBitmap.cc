@@ -0,0 +1,220 @@
+/*
+====================
+File: TerrainBitmap.cc
+Author: Shane Lillie
+Description: Bit-packed terrain bitmap source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#include <cassert>
+#include <algorithm>
+
+#include "TerrainBitmap.h"
+
+
+/*
+ *  TerrainBitmap functions
+ *
+ */
+
+
+int TerrainBitmap::popcount(Word word)
+{
+#if defined __GNUC__
+    return __builtin_popcountll(word);
+#else
+    int count = 0;
+    while(word) {
+        word &= word - 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+
+int TerrainBitmap::lowest_bit(Word word)
+{
+    assert(word);
+
+#if defined __GNUC__
+    return __builtin_ctzll(word);
+#else
+    int bit = 0;
+    while(!(word & 1)) {
+        word >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+
+int TerrainBitmap::highest_bit(Word word)
+{
+    assert(word);
+
+#if defined __GNUC__
+    return WORD_MASK - __builtin_clzll(word);
+#else
+    int bit = 0;
+    while(word >>= 1)
+        ++bit;
+    return bit;
+#endif
+}
+
+
+/*
+ *  TerrainBitmap methods
+ *
+ */
+
+
+TerrainBitmap::TerrainBitmap(int width, int height)
+    : m_width(width), m_height(height),
+        m_words((height + WORD_MASK) >> WORD_SHIFT),
+        m_bits(width * ((height + WORD_MASK) >> WORD_SHIFT), 0)
+{
+    assert(width > 0 && height > 0);
+}
+
+
+void TerrainBitmap::fill_span(int x, int y0, int y1)
+{
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, m_height - 1);
+    if(y0 > y1) return;
+
+    Word* const col = column(x);
+
+    const int w0 = y0 >> WORD_SHIFT, w1 = y1 >> WORD_SHIFT;
+    if(w0 == w1) {
+        col[w0] |= mask(y0 & WORD_MASK, y1 & WORD_MASK);
+        return;
+    }
+
+    col[w0] |= mask(y0 & WORD_MASK, WORD_MASK);
+    for(int i=w0+1; i<w1; ++i)
+        col[i] = ~static_cast<Word>(0);
+    col[w1] |= mask(0, y1 & WORD_MASK);
+}
+
+
+void TerrainBitmap::clear_span(int x, int y0, int y1)
+{
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, m_height - 1);
+    if(y0 > y1) return;
+
+    Word* const col = column(x);
+
+    const int w0 = y0 >> WORD_SHIFT, w1 = y1 >> WORD_SHIFT;
+    if(w0 == w1) {
+        col[w0] &= ~mask(y0 & WORD_MASK, y1 & WORD_MASK);
+        return;
+    }
+
+    col[w0] &= ~mask(y0 & WORD_MASK, WORD_MASK);
+    for(int i=w0+1; i<w1; ++i)
+        col[i] = 0;
+    col[w1] &= ~mask(0, y1 & WORD_MASK);
+}
+
+
+bool TerrainBitmap::any_span(int x, int y0, int y1) const
+{
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, m_height - 1);
+    if(y0 > y1) return false;
+
+    const Word* const col = column(x);
+
+    const int w0 = y0 >> WORD_SHIFT, w1 = y1 >> WORD_SHIFT;
+    if(w0 == w1)
+        return (col[w0] & mask(y0 & WORD_MASK, y1 & WORD_MASK)) != 0;
+
+    if(col[w0] & mask(y0 & WORD_MASK, WORD_MASK))
+        return true;
+    for(int i=w0+1; i<w1; ++i)
+        if(col[i]) return true;
+    return (col[w1] & mask(0, y1 & WORD_MASK)) != 0;
+}
+
+
+int TerrainBitmap::count_span(int x, int y0, int y1) const
+{
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, m_height - 1);
+    if(y0 > y1) return 0;
+
+    const Word* const col = column(x);
+
+    const int w0 = y0 >> WORD_SHIFT, w1 = y1 >> WORD_SHIFT;
+    if(w0 == w1)
+        return popcount(col[w0] & mask(y0 & WORD_MASK, y1 & WORD_MASK));
+
+    int count = popcount(col[w0] & mask(y0 & WORD_MASK, WORD_MASK));
+    for(int i=w0+1; i<w1; ++i)
+        count += popcount(col[i]);
+    return count + popcount(col[w1] & mask(0, y1 & WORD_MASK));
+}
+
+
+int TerrainBitmap::top_span(int x, int y0, int y1) const
+{
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, m_height - 1);
+    if(y0 > y1) return -1;
+
+    const Word* const col = column(x);
+
+    const int w0 = y0 >> WORD_SHIFT, w1 = y1 >> WORD_SHIFT;
+    for(int i=w1; i>=w0; --i) {
+        const Word bits = col[i] & mask(i == w0 ? y0 & WORD_MASK : 0, i == w1 ? y1 & WORD_MASK : WORD_MASK);
+        if(bits)
+            return (i << WORD_SHIFT) + highest_bit(bits);
+    }
+    return -1;
+}
+
+
+int TerrainBitmap::bottom_span(int x, int y0, int y1) const
+{
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, m_height - 1);
+    if(y0 > y1) return -1;
+
+    const Word* const col = column(x);
+
+    const int w0 = y0 >> WORD_SHIFT, w1 = y1 >> WORD_SHIFT;
+    for(int i=w0; i<=w1; ++i) {
+        const Word bits = col[i] & mask(i == w0 ? y0 & WORD_MASK : 0, i == w1 ? y1 & WORD_MASK : WORD_MASK);
+        if(bits)
+            return (i << WORD_SHIFT) + lowest_bit(bits);
+    }
+    return -1;
+}
+
+
+void TerrainBitmap::reset()
+{
+    std::fill(m_bits.begin(), m_bits.end(), static_cast<Word>(0));
+}
@@ -0,0 +1,376 @@
+/*
+====================
+File: TerrainFile.cc
+Author: Shane Lillie
+Description: Terrain file loading/conversion source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+    #include <sys/mman.h>
+#endif
+
+#include "SDL_endian.h"
+
+#include "TerrainFile.h"
+#include "utilities.h"
+
+
+/*
+ *  external globals
+ *
+ */
+
+
+extern int errno;
+
+
+/*
+ *  functions
+ *
+ */
+
+
+// adler-32 of a block of bytes
+Uint32 terrain_checksum(const Uint8* data, unsigned int len)
+{
+    Uint32 a = 1, b = 0;
+    while(len > 0) {
+        // 5552 is the most we can sum before the 32 bits overflow
+        unsigned int n = len < 5552 ? len : 5552;
+        len -= n;
+
+        while(n--) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+
+/*
+ *  TerrainFile class constants
+ *
+ */
+
+
+const char TerrainFile::MAGIC[4] = { 'S', 'T', 'B', '\0' };
+const Uint32 TerrainFile::FILE_VERSION = 1;
+
+
+/*
+ *  TerrainFile functions
+ *
+ */
+
+
+std::vector<Uint8> TerrainFile::default_ramp()
+{
+    // go brown as we get deeper
+    std::vector<Uint8> ramp;
+    for(int color=0; color<=128; ++color) {
+        ramp.push_back(color);
+        ramp.push_back(192 - color);
+        ramp.push_back(6);
+        ramp.push_back(255);
+    }
+    return ramp;
+}
+
+
+bool TerrainFile::is_binary(const std::string& filename)
+{
+    std::ifstream infile(filename.c_str(), std::ios::in | std::ios::binary);
+    if(!infile)
+        return false;
+
+    char magic[4];
+    if(!infile.read(magic, 4))
+        return false;
+    return !std::memcmp(magic, MAGIC, 4);
+}
+
+
+void TerrainFile::parse_set(const std::string& filename, TerrainBitmap& bitmap) throw(TerrainFileException)
+{
+    std::ifstream infile(filename.c_str());
+    if(!infile)
+        throw TerrainFileException(std::string("Could not open terrain file: ") + std::strerror(errno));
+
+    const int width = bitmap.width();
+    const int height = bitmap.height();
+
+    int x = 0;
+    while(!infile.eof() && x < width) {
+        int y = 0;
+        infile >> y;
+
+        if(y >= height)
+            y = height-1;
+        else if(y < 0)
+            y = 0;
+
+        skip_whitespace(infile);
+
+        char ch = infile.get();
+        if(ch == ',') {
+            int count = 0;
+            infile >> count;
+
+            if(count && count > 0) {
+                int total = x + count;
+                if(total > width)
+                    total = width;
+
+                for(int j=x; j<total; ++j)
+                    bitmap.fill_span(j, 0, y);
+                x = total;
+            }
+        } else if(ch == 'r') {
+            int top = 0;
+            infile >> top;
+
+            int step = 1;
+
+            skip_whitespace(infile);
+
+            ch = infile.get();
+            if(ch == ',')
+                infile >> step;
+            else
+                infile.putback(ch);
+
+            const int y_count = top - y;
+            if(y_count < 0 && step > 0 || y_count > 0 && step < 0)
+                step *= -1;
+
+            int total = x + (std::abs(y_count) / std::abs(step));
+            if(total > width)
+                total = width;
+
+            for(int i=x; i<total; ++i) {
+                bitmap.fill_span(i, 0, y);
+                y += step;
+            }
+            x = total;
+        } else {
+            infile.putback(ch);
+
+            bitmap.fill_span(x, 0, y);
+            x++;
+        }
+    }
+
+    infile.clear();
+    infile.close();
+}
+
+
+void TerrainFile::write(const std::string& filename, const TerrainBitmap& bitmap, const std::vector<Uint8>& ramp) throw(TerrainFileException)
+{
+    assert(ramp.size() % 4 == 0);
+
+    const unsigned int ramp_bytes = ramp.size();
+    const unsigned int bitmap_offset = (sizeof(Header) + ramp_bytes + 7) & ~7;
+    const unsigned int words = bitmap.width() * bitmap.words_per_column();
+
+    // build everything after the header in memory so we can checksum it
+    std::vector<Uint8> body(bitmap_offset - sizeof(Header) + (words * sizeof(TerrainBitmap::Word)), 0);
+    if(ramp_bytes)
+        std::memcpy(&body[0], &ramp[0], ramp_bytes);
+
+    Uint8* const out = &body[bitmap_offset - sizeof(Header)];
+    for(int x=0; x<bitmap.width(); ++x) {
+        const TerrainBitmap::Word* const column = bitmap.column(x);
+        for(int i=0; i<bitmap.words_per_column(); ++i) {
+            const TerrainBitmap::Word word = SDL_SwapLE64(column[i]);
+            std::memcpy(out + (((x * bitmap.words_per_column()) + i) * sizeof(TerrainBitmap::Word)), &word, sizeof(word));
+        }
+    }
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, 4);
+    header.version = SDL_SwapLE32(FILE_VERSION);
+    header.width = SDL_SwapLE32(bitmap.width());
+    header.height = SDL_SwapLE32(bitmap.height());
+    header.words_per_column = SDL_SwapLE32(bitmap.words_per_column());
+    header.ramp_size = SDL_SwapLE32(ramp_bytes / 4);
+    header.bitmap_offset = SDL_SwapLE32(bitmap_offset);
+    header.checksum = SDL_SwapLE32(terrain_checksum(&body[0], body.size()));
+
+    std::ofstream outfile(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!outfile)
+        throw TerrainFileException(std::string("Could not create terrain file: ") + std::strerror(errno));
+
+    outfile.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    outfile.write(reinterpret_cast<const char*>(&body[0]), body.size());
+    if(!outfile)
+        throw TerrainFileException(std::string("Could not write terrain file: ") + std::strerror(errno));
+}
+
+
+void TerrainFile::convert(const std::string& set_filename, const std::string& filename, int width, int height) throw(TerrainFileException)
+{
+    TerrainBitmap bitmap(width, height);
+    parse_set(set_filename, bitmap);
+    write(filename, bitmap, default_ramp());
+}
+
+
+/*
+ *  TerrainFile methods
+ *
+ */
+
+
+TerrainFile::TerrainFile(const std::string& filename) throw(TerrainFileException)
+    : m_data(NULL), m_size(0), m_header(NULL)
+{
+#if defined WIN32
+    m_file = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(m_file == INVALID_HANDLE_VALUE)
+        throw TerrainFileException("Could not open terrain file: " + filename);
+
+    m_size = GetFileSize(m_file, NULL);
+
+    m_mapping = CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(!m_mapping) {
+        CloseHandle(m_file);
+        throw TerrainFileException("Could not map terrain file: " + filename);
+    }
+
+    m_data = static_cast<const Uint8*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if(!m_data) {
+        CloseHandle(m_mapping);
+        CloseHandle(m_file);
+        throw TerrainFileException("Could not map terrain file: " + filename);
+    }
+#else
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw TerrainFileException(std::string("Could not open terrain file: ") + std::strerror(errno));
+
+    struct stat buf;
+    if(fstat(fd, &buf)) {
+        close(fd);
+        throw TerrainFileException(std::string("Could not stat terrain file: ") + std::strerror(errno));
+    }
+    m_size = buf.st_size;
+
+    void* const data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(data == MAP_FAILED)
+        throw TerrainFileException(std::string("Could not map terrain file: ") + std::strerror(errno));
+    m_data = static_cast<const Uint8*>(data);
+#endif
+
+    m_header = reinterpret_cast<const Header*>(m_data);
+
+    /* validate the header */
+
+    std::string err;
+    if(m_size < sizeof(Header) || std::memcmp(m_header->magic, MAGIC, 4))
+        err = "Not a binary terrain file: ";
+    else if(SDL_SwapLE32(m_header->version) != FILE_VERSION)
+        err = "Unsupported terrain file version: ";
+    else {
+        // the map is sized from the header, so it can't be empty or too big for an int
+        const Uint32 width = SDL_SwapLE32(m_header->width), height = SDL_SwapLE32(m_header->height);
+
+        // 64 bits, so a huge offset or size can't wrap around and pass
+        const Uint64 words = static_cast<Uint64>(width) * SDL_SwapLE32(m_header->words_per_column);
+        const Uint64 ramp_bytes = static_cast<Uint64>(SDL_SwapLE32(m_header->ramp_size)) * 4;
+        const Uint64 offset = SDL_SwapLE32(m_header->bitmap_offset);
+
+        if(!width || !height || width > static_cast<Uint32>(INT_MAX) || height > static_cast<Uint32>(INT_MAX)
+                || SDL_SwapLE32(m_header->words_per_column) != ((static_cast<Uint64>(height) + TerrainBitmap::WORD_MASK) >> TerrainBitmap::WORD_SHIFT)
+                || offset < sizeof(Header) + ramp_bytes || offset % 8 || offset > m_size
+                || words * sizeof(TerrainBitmap::Word) > m_size - offset)
+            err = "Corrupt terrain file header: ";
+        else if(terrain_checksum(m_data + sizeof(Header), m_size - sizeof(Header)) != SDL_SwapLE32(m_header->checksum))
+            err = "Terrain file checksum mismatch: ";
+    }
+
+    if(!err.empty()) {
+        unmap();
+        throw TerrainFileException(err + filename);
+    }
+}
+
+
+TerrainFile::~TerrainFile()
+{
+    unmap();
+}
+
+
+void TerrainFile::copy_bitmap(TerrainBitmap& bitmap) const
+{
+    assert(bitmap.width() == width() && bitmap.height() == height());
+
+    const Uint8* const bits = m_data + SDL_SwapLE32(m_header->bitmap_offset);
+
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+    // the layouts match, so this is one straight copy
+    std::memcpy(bitmap.column(0), bits, bitmap.bytes());
+#else
+    const TerrainBitmap::Word* const words = reinterpret_cast<const TerrainBitmap::Word*>(bits);
+    TerrainBitmap::Word* const out = bitmap.column(0);
+    for(unsigned int i=0; i<bitmap.bytes() / sizeof(TerrainBitmap::Word); ++i)
+        out[i] = SDL_SwapLE64(words[i]);
+#endif
+}
+
+
+void TerrainFile::unmap()
+{
+    if(!m_data)
+        return;
+
+#if defined WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+#else
+    munmap(const_cast<Uint8*>(m_data), m_size);
+#endif
+
+    m_data = NULL;
+    m_header = NULL;
+    m_size = 0;
+}
@@ -0,0 +1,206 @@
+/*
+====================
+File: TextAtlas.cc
+Author: Shane Lillie
+Description: Glyph atlas text renderer source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#include <algorithm>
+#include <cstring>
+
+#include "SDL_opengl.h"
+
+#include "TextAtlas.h"
+#include "TextureCache.h"
+#include "SEarth.h"
+
+
+/*
+ *  TextAtlas class constants
+ *
+ */
+
+
+const int TextAtlas::ATLAS_WIDTH = 256;
+
+
+/*
+ *  TextAtlas methods
+ *
+ */
+
+
+TextAtlas::TextAtlas(const LogicalFont& font)
+    : m_font(font), m_atlas_height(0), m_texture(0), m_built(false)
+{
+    std::memset(m_glyphs, 0, sizeof(m_glyphs));
+}
+
+
+TextAtlas::~TextAtlas()
+{
+    TextureCache::release(m_texture);
+}
+
+
+int TextAtlas::width(const char* text)
+{
+    if(!m_built && !build())
+        return 0;
+
+    int width = 0;
+    for(; *text; ++text) {
+        const unsigned char ch = *text;
+        if(ch >= FIRST_GLYPH && ch <= LAST_GLYPH)
+            width += m_glyphs[ch - FIRST_GLYPH].width;
+    }
+    return width;
+}
+
+
+void TextAtlas::draw(const char* text, int x, int y)
+{
+    if(!m_built && !build())
+        return;
+
+    const float atlas_height = static_cast<float>(m_atlas_height);
+
+    for(; *text; ++text) {
+        const unsigned char ch = *text;
+        if(ch < FIRST_GLYPH || ch > LAST_GLYPH)
+            continue;
+
+        const Glyph& glyph = m_glyphs[ch - FIRST_GLYPH];
+
+        const float x1 = static_cast<float>(x), y1 = static_cast<float>(y);
+        const float x2 = x1 + glyph.width, y2 = y1 + glyph.height;
+
+        // the atlas rows go top down
+        const float s1 = static_cast<float>(glyph.x) / ATLAS_WIDTH;
+        const float s2 = static_cast<float>(glyph.x + glyph.width) / ATLAS_WIDTH;
+        const float t1 = static_cast<float>(glyph.y + glyph.height) / atlas_height;
+        const float t2 = static_cast<float>(glyph.y) / atlas_height;
+
+        const float vertices[] = { x1, y1, x2, y1, x2, y2, x1, y2 };
+        const float texcoords[] = { s1, t1, s2, t1, s2, t2, s1, t2 };
+        m_vertices.insert(m_vertices.end(), vertices, vertices + 8);
+        m_texcoords.insert(m_texcoords.end(), texcoords, texcoords + 8);
+
+        x += glyph.width;
+    }
+}
+
+
+void TextAtlas::flush()
+{
+    if(m_vertices.empty())
+        return;
+
+    glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(m_texture));
+    glNormal3f(0.0f, 0.0f, 1.0f);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    glVertexPointer(2, GL_FLOAT, 0, &m_vertices[0]);
+    glTexCoordPointer(2, GL_FLOAT, 0, &m_texcoords[0]);
+    glDrawArrays(GL_QUADS, 0, m_vertices.size() / 2);
+
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    // clear() keeps the capacity
+    m_vertices.clear();
+    m_texcoords.clear();
+}
+
+
+bool TextAtlas::build()
+{
+    if(!m_font.valid())
+        return false;
+
+    const SDL_Color white = { 0xff, 0xff, 0xff, 0x00 };
+    const int line_height = m_font.height();
+
+    // render every glyph once, packing them left to right
+    SDL_Surface* surfaces[LAST_GLYPH - FIRST_GLYPH + 1];
+
+    int x = 0, y = 0;
+    for(int ch=FIRST_GLYPH; ch<=LAST_GLYPH; ++ch) {
+        Glyph& glyph = m_glyphs[ch - FIRST_GLYPH];
+
+        int w = 0, h = 0;
+        const char text[2] = { static_cast<char>(ch), '\0' };
+        SDL_Surface* const surface = m_font.render_blended(text, white, w, h);
+        surfaces[ch - FIRST_GLYPH] = surface;
+
+        // some fonts won't render a space
+        if(!surface)
+            w = line_height / 3;
+
+        if(x + w > ATLAS_WIDTH) {
+            x = 0;
+            y += line_height;
+        }
+
+        glyph.x = x;
+        glyph.y = y;
+        glyph.width = w;
+        glyph.height = line_height;
+
+        x += w;
+    }
+
+    m_atlas_height = 1;
+    while(m_atlas_height < y + line_height)
+        m_atlas_height <<= 1;
+
+    // copy them into one transparent RGBA image
+    std::vector<Uint8> pixels(ATLAS_WIDTH * m_atlas_height * 4, 0);
+    for(int i=0; i<=LAST_GLYPH - FIRST_GLYPH; ++i) {
+        SDL_Surface* const surface = surfaces[i];
+        if(!surface)
+            continue;
+
+        const Glyph& glyph = m_glyphs[i];
+        const int w = std::min(glyph.width, static_cast<int>(surface->w));
+        const int h = std::min(glyph.height, static_cast<int>(surface->h));
+
+        for(int row=0; row<h; ++row) {
+            const Uint8* const src = static_cast<const Uint8*>(surface->pixels) + (row * surface->pitch);
+            std::memcpy(&pixels[(((glyph.y + row) * ATLAS_WIDTH) + glyph.x) * 4], src, w * 4);
+        }
+
+        SDL_FreeSurface(surface);
+    }
+
+    m_texture = TextureCache::create("hud glyphs", ATLAS_WIDTH, m_atlas_height, GL_RGBA, &pixels[0]);
+
+    // nearest so the glyphs stay crisp (create() leaves it bound)
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    SEarth::log("Built %dx%d HUD glyph atlas\n", ATLAS_WIDTH, m_atlas_height);
+
+    m_built = true;
+    return true;
+}
@@ -0,0 +1,251 @@
+/*
+====================
+File: TextureCache.cc
+Author: Shane Lillie
+Description: Texture cache source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "TextureCache.h"
+#include "SEarth.h"
+
+
+/*
+ *  constants
+ *
+ */
+
+
+#if defined WIN32
+    #define GL_BGR GL_BGR_EXT
+#endif
+
+
+/*
+ *  structures
+ *
+ */
+
+
+struct CachedTexture
+{
+    GLuint texture;
+    int width, height;
+    int references;
+
+    CachedTexture() : texture(0), width(0), height(0), references(0)
+    {
+    }
+};
+
+
+/*
+ *  globals
+ *
+ */
+
+
+std::map<std::string, CachedTexture> g_textures;
+
+// what each texture is cached under, so release() doesn't search
+std::map<GLuint, std::string> g_texture_names;
+
+int g_texture_hits = 0;
+int g_texture_uploads = 0;
+unsigned int g_texture_uploaded = 0;
+
+
+/*
+ *  TextureCache functions
+ *
+ */
+
+
+std::string TextureCache::surface_name(int surface)
+{
+    char name[32];
+    std::snprintf(name, 32, "surface %d", surface);
+    return name;
+}
+
+
+unsigned int TextureCache::acquire(const std::string& name)
+{
+    std::map<std::string, CachedTexture>::iterator it = g_textures.find(name);
+    if(it == g_textures.end())
+        return 0;
+
+    it->second.references++;
+    g_texture_hits++;
+    return it->second.texture;
+}
+
+
+unsigned int TextureCache::acquire(int surface)
+{
+    if(surface < 0)
+        return 0;
+
+    const std::string name(surface_name(surface));
+
+    const unsigned int texture = acquire(name);
+    if(texture)
+        return texture;
+
+    GLenum format = GL_BGRA;
+    if(SEarth::surface_Bpp(surface) == 3)
+        format = GL_BGR;
+    else if(SEarth::surface_Bpp(surface) != 4) {
+        SEarth::error("%s must be 24 or 32 bits\n", name.c_str());
+        return 0;
+    }
+
+    return create(name, SEarth::surface_width(surface), SEarth::surface_height(surface), format, SEarth::surface_pixels(surface));
+}
+
+
+unsigned int TextureCache::create(const std::string& name, int width, int height, GLenum format, const void* pixels)
+{
+    assert(GL_RGBA == format || GL_BGRA == format || GL_BGR == format);
+
+    // swizzle to RGBA here, so the driver doesn't on every upload
+    const Uint8* data = static_cast<const Uint8*>(pixels);
+
+    std::vector<Uint8> rgba;
+    if(format != GL_RGBA) {
+        const int Bpp = GL_BGR == format ? 3 : 4;
+
+        rgba.resize(width * height * 4);
+        for(int i=0; i<width * height; ++i) {
+            const Uint8* const src = data + (i * Bpp);
+            Uint8* const dst = &rgba[i * 4];
+
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst[3] = 4 == Bpp ? src[3] : 255;
+        }
+        data = &rgba[0];
+    }
+
+    CachedTexture& cached = g_textures[name];
+    if(!cached.texture) {
+        glGenTextures(1, &cached.texture);
+        g_texture_names[cached.texture] = name;
+        glBindTexture(GL_TEXTURE_2D, cached.texture);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    } else
+        glBindTexture(GL_TEXTURE_2D, cached.texture);
+
+    // same size, so just replace the pixels
+    if(cached.width == width && cached.height == height)
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+
+    cached.width = width;
+    cached.height = height;
+    cached.references++;
+
+    g_texture_uploads++;
+    g_texture_uploaded += width * height * 4;
+    return cached.texture;
+}
+
+
+void TextureCache::release(unsigned int texture)
+{
+    if(!texture)
+        return;
+
+    std::map<GLuint, std::string>::const_iterator name = g_texture_names.find(texture);
+    if(name == g_texture_names.end()) {
+        SEarth::error("Released texture %u isn't cached\n", texture);
+        return;
+    }
+
+    CachedTexture& cached = g_textures[name->second];
+    assert(cached.references > 0);
+    cached.references--;
+}
+
+
+void TextureCache::purge()
+{
+    std::map<std::string, CachedTexture>::iterator it = g_textures.begin();
+    while(it != g_textures.end()) {
+        if(!it->second.references) {
+            glDeleteTextures(1, &it->second.texture);
+            g_texture_names.erase(it->second.texture);
+            g_textures.erase(it++);
+        } else
+            ++it;
+    }
+}
+
+
+void TextureCache::clear()
+{
+    for(std::map<std::string, CachedTexture>::iterator it = g_textures.begin(); it != g_textures.end(); ++it)
+        glDeleteTextures(1, &it->second.texture);
+    g_textures.clear();
+    g_texture_names.clear();
+}
+
+
+TextureCache::Stats TextureCache::stats()
+{
+    Stats stats;
+    stats.resident = g_textures.size();
+    stats.referenced = 0;
+    stats.bytes = 0;
+    stats.hits = g_texture_hits;
+    stats.uploads = g_texture_uploads;
+    stats.uploaded = g_texture_uploaded;
+
+    for(std::map<std::string, CachedTexture>::const_iterator it = g_textures.begin(); it != g_textures.end(); ++it) {
+        if(it->second.references)
+            stats.referenced++;
+        stats.bytes += it->second.width * it->second.height * 4;
+    }
+    return stats;
+}
+
+
+void TextureCache::dump()
+{
+    for(std::map<std::string, CachedTexture>::const_iterator it = g_textures.begin(); it != g_textures.end(); ++it) {
+        const CachedTexture& cached = it->second;
+        SEarth::log("Texture %u: %s, %dx%d, %d references\n", cached.texture, it->first.c_str(),
+            cached.width, cached.height, cached.references);
+    }
+
+    const Stats total = stats();
+    SEarth::log("%d textures resident (%d referenced), %u bytes, %d hits, %d uploads\n",
+        total.resident, total.referenced, total.bytes, total.hits, total.uploads);
+}
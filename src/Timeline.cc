@@ -0,0 +1,240 @@
+/*
+====================
+File: Timeline.cc
+Author: Shane Lillie
+Description: Trace event timeline source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+
+#include <cstdio>
+#include <vector>
+
+#include "Timeline.h"
+#include "FrameTimer.h"
+#include "SEarth.h"
+
+
+/*
+ *  structures
+ *
+ */
+
+
+struct TimelineEvent
+{
+    const char* name;
+    char type;          // Chrome trace phase: X, C, b or e
+
+    double time;
+    double value;       // duration of a span or value of a counter
+    int id;             // which object
+};
+
+
+/*
+ *  globals
+ *
+ */
+
+
+std::vector<TimelineEvent> g_timeline_events;
+std::FILE* g_timeline_file = NULL;
+
+double g_timeline_start = 0.0;
+int g_timeline_objects = 0;
+int g_timeline_dropped = 0;
+
+
+/*
+ *  functions
+ *
+ */
+
+
+void record(const char* name, char type, double time, double value, int id)
+{
+    if(!g_timeline_file)
+        return;
+
+    // never grow the buffer while recording
+    if(static_cast<int>(g_timeline_events.size()) >= Timeline::MAX_EVENTS) {
+        ++g_timeline_dropped;
+        return;
+    }
+
+    TimelineEvent event;
+    event.name = name;
+    event.type = type;
+    event.time = time - g_timeline_start;
+    event.value = value;
+    event.id = id;
+    g_timeline_events.push_back(event);
+}
+
+
+/*
+ *  Timeline class constants
+ *
+ */
+
+
+const int Timeline::MAX_EVENTS = 262144;
+const int Timeline::FLUSH_EVENTS = 65536;
+
+
+/*
+ *  Timeline::Span methods
+ *
+ */
+
+
+Timeline::Span::Span(const char* name)
+    : m_name(name), m_start(recording() ? FrameTimer::now() : -1.0)
+{
+}
+
+
+Timeline::Span::~Span()
+{
+    if(m_start >= 0.0)
+        span(m_name, m_start, FrameTimer::now());
+}
+
+
+/*
+ *  Timeline functions
+ *
+ */
+
+
+bool Timeline::start(const std::string& filename)
+{
+    if(g_timeline_file)
+        stop();
+
+    g_timeline_file = std::fopen(filename.c_str(), "w");
+    if(!g_timeline_file) {
+        SEarth::error("Could not open trace file %s\n", filename.c_str());
+        return false;
+    }
+
+    g_timeline_events.reserve(MAX_EVENTS);
+    g_timeline_start = FrameTimer::now();
+    g_timeline_dropped = 0;
+
+    std::fprintf(g_timeline_file, "{\"traceEvents\":[\n"
+        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"main\"}}");
+
+    SEarth::log("Recording trace to %s\n", filename.c_str());
+    return true;
+}
+
+
+void Timeline::stop()
+{
+    if(!g_timeline_file)
+        return;
+
+    flush();
+
+    std::fprintf(g_timeline_file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    std::fclose(g_timeline_file);
+    g_timeline_file = NULL;
+
+    if(g_timeline_dropped > 0)
+        SEarth::error("Trace buffer overflowed, dropped %d events\n", g_timeline_dropped);
+
+    // give the buffer back
+    std::vector<TimelineEvent>().swap(g_timeline_events);
+}
+
+
+bool Timeline::recording()
+{
+    return NULL != g_timeline_file;
+}
+
+
+void Timeline::span(const char* name, double start, double end)
+{
+    record(name, 'X', start, end - start, 0);
+}
+
+
+void Timeline::counter(const char* name, double value)
+{
+    record(name, 'C', FrameTimer::now(), value, 0);
+}
+
+
+int Timeline::begin_object(const char* name)
+{
+    const int id = ++g_timeline_objects;
+    record(name, 'b', FrameTimer::now(), 0.0, id);
+    return id;
+}
+
+
+void Timeline::end_object(const char* name, int id)
+{
+    record(name, 'e', FrameTimer::now(), 0.0, id);
+}
+
+
+void Timeline::end_frame()
+{
+    if(static_cast<int>(g_timeline_events.size()) < FLUSH_EVENTS)
+        return;
+
+    // the write shows up on the timeline, so it
+    // can't be mistaken for a slow frame
+    const double start = FrameTimer::now();
+    flush();
+    span("timeline flush", start, FrameTimer::now());
+}
+
+
+void Timeline::flush()
+{
+    if(!g_timeline_file)
+        return;
+
+    for(std::vector<TimelineEvent>::const_iterator event = g_timeline_events.begin(); event != g_timeline_events.end(); ++event) {
+        switch(event->type)
+        {
+        case 'X':
+            std::fprintf(g_timeline_file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+                event->name, event->time, event->value);
+            break;
+        case 'C':
+            std::fprintf(g_timeline_file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"value\":%g}}",
+                event->name, event->time, event->value);
+            break;
+        default:
+            std::fprintf(g_timeline_file, ",\n{\"name\":\"%s\",\"cat\":\"object\",\"ph\":\"%c\",\"id\":%d,\"ts\":%.3f,\"pid\":1,\"tid\":1}",
+                event->name, event->type, event->id, event->time);
+            break;
+        }
+    }
+
+    // clear() keeps the capacity
+    g_timeline_events.clear();
+}
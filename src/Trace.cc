@@ -0,0 +1,183 @@
+/*
+====================
+File: Trace.cc
+Author: Shane Lillie
+Description: Function trace source
+
+Copyright 2003 Energon Software
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2, or (at your option)
+any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+====================
+*/
+
+
+
+#include <algorithm>
+
+#if defined WIN32
+    #include <windows.h>
+#endif
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include "Trace.h"
+
+
+/*
+ *  Trace class constants
+ *
+ */
+
+
+const int Trace::RING_SIZE = 256;
+const int Trace::MAX_THREADS = 16;
+
+
+/*
+ *  constants
+ *
+ */
+
+
+#if defined WIN32
+    #define THREAD_LOCAL __declspec(thread)
+#else
+    #define THREAD_LOCAL __thread
+#endif
+
+
+/*
+ *  structures
+ *
+ */
+
+
+struct TraceEntry
+{
+    const char* function;
+    int depth;
+};
+
+
+// only the thread that owns it writes to a ring
+struct TraceRing
+{
+    TraceEntry entries[Trace::RING_SIZE];
+
+    // entries ever written, bumped after the entry is
+    // so a reader never sees one half written
+    volatile unsigned int count;
+
+    int depth;
+    Uint32 thread;
+};
+
+
+/*
+ *  globals
+ *
+ */
+
+
+TraceRing g_trace_rings[Trace::MAX_THREADS];
+
+// rings handed out, can go past MAX_THREADS
+volatile long g_trace_claimed = 0;
+
+// this thread's ring, NULL until its first trace
+// (or for good if there weren't any left)
+THREAD_LOCAL TraceRing* g_trace_ring = NULL;
+THREAD_LOCAL bool g_trace_has_ring = false;
+
+
+/*
+ *  functions
+ *
+ */
+
+
+TraceRing* trace_ring()
+{
+    if(g_trace_has_ring)
+        return g_trace_ring;
+    g_trace_has_ring = true;
+
+#if defined WIN32
+    const long index = InterlockedIncrement(&g_trace_claimed) - 1;
+#else
+    const long index = __sync_fetch_and_add(&g_trace_claimed, 1);
+#endif
+    if(index >= Trace::MAX_THREADS)
+        return NULL;
+
+    g_trace_ring = g_trace_rings + index;
+    g_trace_ring->thread = SDL_ThreadID();
+    return g_trace_ring;
+}
+
+
+/*
+ *  Trace functions
+ *
+ */
+
+
+void Trace::enter(const char* function)
+{
+    TraceRing* const ring = trace_ring();
+    if(!ring)
+        return;
+
+    TraceEntry& entry = ring->entries[ring->count % RING_SIZE];
+    entry.function = function;
+    entry.depth = ring->depth++;
+
+    ring->count = ring->count + 1;
+}
+
+
+void Trace::leave()
+{
+    if(g_trace_ring)
+        g_trace_ring->depth--;
+}
+
+
+void Trace::dump(std::ostream& out, int count)
+{
+#if !defined TRACE_ENABLED
+    out << "Function tracing isn't compiled in" << std::endl;
+#endif
+
+    const int rings = std::min(static_cast<int>(g_trace_claimed), MAX_THREADS);
+    for(int i=0; i<rings; ++i) {
+        const TraceRing& ring = g_trace_rings[i];
+
+        // the ring may still be going, so take the count once
+        const unsigned int total = ring.count;
+        const unsigned int shown = std::min(total, static_cast<unsigned int>(std::min(count, RING_SIZE)));
+
+        out << "Thread " << ring.thread << ", last " << shown << " of " << total << " calls:" << std::endl;
+        for(unsigned int j=total - shown; j<total; ++j) {
+            const TraceEntry& entry = ring.entries[j % RING_SIZE];
+
+            out << "    ";
+            for(int k=0; k<entry.depth; ++k)
+                out << "  ";
+            out << entry.function << std::endl;
+        }
+    }
+}
@@ -24,6 +24,7 @@ Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 
 #include <cassert>
+#include <cctype>
 #include <memory>
 #include <iostream>
 
@@ -34,7 +35,8 @@ Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 #include "main.h"
 #include "SEarth.h"
-#include "Callstack.h"
+#include "TerrainFile.h"
+#include "Trace.h"
 
 
 /*
@@ -54,7 +56,7 @@ extern int errno;
 
 inline void print_usage()
 {
-    ENTER_FUNCTION(print_usage);
+    TRACE_FUNCTION(print_usage);
 
     std::cout << "Usage: " << PROGRAM_NAME << "  [options]" << std::endl << std::endl
             << "Options:" << std::endl
@@ -63,13 +65,59 @@ inline void print_usage()
             << "-window\t\tRun in window mode" << std::endl
             << "-m\t\tTurn music off" << std::endl
             << "-s\t\tTurn sound off" << std::endl
+            << "-convert [set] [stb] [width height]\tConvert a text terrain to the binary format (default 800x600)" << std::endl
+            << "-headless [shots]\tSimulate shots without a window" << std::endl
+            << "-seed [seed]\tSeed the simulation" << std::endl
+            << "-threads [count]\tSimulation threads (default one per processor)" << std::endl
+            << "-trace [file]\tRecord a Chrome trace of the session" << std::endl
+            << "-weapon [shell|cluster|mirv]\tWeapon to fire" << std::endl
+            << "-tanks [count]\tTanks in the match" << std::endl
             << "-h\t\tPrint this message" << std::endl << std::endl;
 }
 
 
+// the value after option i (and moves i past it),
+// prints the usage and exits if there isn't one
+const char* option_value(const int argc, char* const argv[], int& i)
+{
+    if(i + 1 >= argc) {
+        std::cout << std::endl;
+        print_usage();
+        exit(1);
+    }
+    return argv[++i];
+}
+
+
+// true if arg is all digits
+bool is_number(const char* const arg)
+{
+    if(!*arg)
+        return false;
+
+    for(const char* c=arg; *c; ++c)
+        if(!isdigit(static_cast<unsigned char>(*c)))
+            return false;
+    return true;
+}
+
+
+// option_value() as a count, which has to be positive
+int count_value(const int argc, char* const argv[], int& i)
+{
+    const int count = std::atoi(option_value(argc, argv, i));
+    if(count <= 0) {
+        std::cout << std::endl;
+        print_usage();
+        exit(1);
+    }
+    return count;
+}
+
+
 bool process_arguments(const int argc, char* const argv[], SEarth* const searth)
 {
-    ENTER_FUNCTION(process_arguments);
+    TRACE_FUNCTION(process_arguments);
 
     assert(searth);
 
@@ -81,7 +129,7 @@ bool process_arguments(const int argc, char* const argv[], SEarth* const searth)
 /* FIXME: verify the depth argument */
     for(int i=1; i<argc; ++i) {
         if(!strcmp("-d", argv[i]) || !strcmp("-depth", argv[i]))
-            searth->set_depth(std::atoi(argv[++i]));
+            searth->set_depth(std::atoi(option_value(argc, argv, i)));
         else if(!strcmp("-f", argv[i]) || !strcmp("-fullscreen", argv[i]))
             searth->set_fullscreen(true);
         else if(!strcmp("-window", argv[i]))
@@ -90,7 +138,68 @@ bool process_arguments(const int argc, char* const argv[], SEarth* const searth)
             searth->set_music(false);
         else if(!strcmp("-s", argv[i]))
             searth->set_sounds(false);
-        else if(!strcmp("-h", argv[i]) || !strcmp("-help", argv[i])) {
+        else if(!strcmp("-threads", argv[i]))
+            searth->set_threads(std::atoi(option_value(argc, argv, i)));
+        else if(!strcmp("-tanks", argv[i]))
+            searth->set_tanks(std::atoi(option_value(argc, argv, i)));
+        else if(!strcmp("-trace", argv[i]))
+            searth->set_trace(option_value(argc, argv, i));
+        else if(!strcmp("-weapon", argv[i])) {
+            const char* const weapon = option_value(argc, argv, i);
+            if(!strcmp("shell", weapon))
+                searth->set_weapon(SEarth::Shell);
+            else if(!strcmp("cluster", weapon))
+                searth->set_weapon(SEarth::ClusterBomb);
+            else if(!strcmp("mirv", weapon))
+                searth->set_weapon(SEarth::Mirv);
+            else {
+                std::cout << std::endl;
+                print_usage();
+                exit(1);
+            }
+        }
+        else if(!strcmp("-seed", argv[i]))
+            searth->set_seed(std::strtoul(option_value(argc, argv, i), NULL, 10));
+        else if(!strcmp("-headless", argv[i])) {
+            searth->set_headless(count_value(argc, argv, i));
+            searth->set_music(false);
+            searth->set_sounds(false);
+        }
+        else if(!strcmp("-convert", argv[i])) {
+            if(i + 2 >= argc) {
+                print_usage();
+                exit(1);
+            }
+
+            // .set files don't say how big they are,
+            // the size is only taken if it's both numbers
+            int width = DEFAULT_WIDTH, height = DEFAULT_HEIGHT;
+            if(i + 3 < argc && is_number(argv[i+3])) {
+                if(i + 4 >= argc || !is_number(argv[i+4])) {
+                    std::cout << std::endl;
+                    print_usage();
+                    exit(1);
+                }
+
+                width = std::atoi(argv[i+3]);
+                height = std::atoi(argv[i+4]);
+                if(width <= 0 || height <= 0) {
+                    std::cout << std::endl;
+                    print_usage();
+                    exit(1);
+                }
+            }
+
+            try {
+                TerrainFile::convert(argv[i+1], argv[i+2], width, height);
+            } catch(TerrainFile::TerrainFileException& e) {
+                std::cerr << "Terrain conversion failed: " << e.what() << std::endl;
+                exit(1);
+            }
+
+            std::cout << "Converted " << argv[i+1] << " to " << argv[i+2] << " (" << width << "x" << height << ")" << std::endl;
+            exit(0);
+        } else if(!strcmp("-h", argv[i]) || !strcmp("-help", argv[i])) {
             std::cout << std::endl;
             print_usage();
             exit(0);
@@ -104,10 +213,20 @@ bool process_arguments(const int argc, char* const argv[], SEarth* const searth)
 }
 
 
+// the -headless shot count, 0 if it wasn't passed
+int headless_shots(const int argc, char* const argv[])
+{
+    for(int i=1; i<argc; ++i)
+        if(!strcmp("-headless", argv[i]))
+            return count_value(argc, argv, i);
+    return 0;
+}
+
+
 // ensures the data directory exists
 bool test_datadir()
 {
-    ENTER_FUNCTION(test_datadir);
+    TRACE_FUNCTION(test_datadir);
 
     struct stat buf;
     if(stat(SEarth::data_directory().c_str(), &buf)) {
@@ -128,7 +247,15 @@ bool test_datadir()
 
 int main(int argc, char* argv[])
 {
-    ENTER_FUNCTION(main);
+    TRACE_FUNCTION(main);
+
+    // headless runs on machines without a display,
+    // so SDL has to come up without one
+    // (a bad count exits here, before SDL starts)
+    if(headless_shots(argc, argv) > 0) {
+        putenv(const_cast<char*>("SDL_VIDEODRIVER=dummy"));
+        putenv(const_cast<char*>("SDL_AUDIODRIVER=dummy"));
+    }
 
     std::auto_ptr<SEarth> searth;
     try {
@@ -148,10 +275,8 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    searth->main();
+    if(!searth->main())
+        return 1;
 
-#if defined DEBUG
-    Callstack::dump_calls(std::cout);
-#endif
     return 0;
 }